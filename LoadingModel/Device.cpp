@@ -74,10 +74,11 @@ bool LoadModelApp::isDeviceSuitable(VkPhysicalDevice device) {
 	// Check that this device has the correct queues that we will use
 	QueueFamilyIndices indices = findQueueFamilies(device);
 	// Check that this device supports all the extension we will need
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
+	// (headless needs none, so any device will do, even a software one)
+	bool extensionsSupported = mHeadless || checkDeviceExtensionSupport(device);
 	// If the extension is supported the see if the swapchain is compatible with the surface
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	bool swapChainAdequate = mHeadless;
+	if (extensionsSupported && !mHeadless) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
@@ -137,8 +138,11 @@ void LoadModelApp::createLogicalDevice() {
 		createInfo.enabledLayerCount = 0;
 	}
 	// Enable the required extensions on this device
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(mDeviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = mDeviceExtensions.data();
+	// (no swapchain without a window)
+	if (!mHeadless) {
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(mDeviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = mDeviceExtensions.data();
+	}
 
 	// Finally, try to create the logical device
 	if (vkCreateDevice(mPhysicalDevice, &createInfo, nullptr, &mDevice) != VK_SUCCESS) {
@@ -181,9 +185,14 @@ QueueFamilyIndices LoadModelApp::findQueueFamilies(VkPhysicalDevice device) {
 		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
 			indices.graphicsFamily = i;
 		}
-		// Check if this queue can render to our surface
+		// Check if this queue can render to our surface (headless presents nothing,
+		// the graphics queue stands in)
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+		if (mHeadless) {
+			presentSupport = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT ? VK_TRUE : VK_FALSE;
+		} else {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+		}
 		if (presentSupport) {
 			indices.presentFamily = i;
 		}
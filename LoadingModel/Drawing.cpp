@@ -135,10 +135,16 @@ void LoadModelApp::drawFrame() {
 	vkWaitForFences(mDevice, 1, &mInFlightFences[mCurrentFrame], VK_TRUE, UINT64_MAX);
 
 	uint32_t imageIndex;
-	// Query for the index of the next available image in the swapchain
-	// We also pass down async object to signal
-	VkResult result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX,
-		mImageAvailableSemaphores[mCurrentFrame], VK_NULL_HANDLE, &imageIndex);
+	VkResult result = VK_SUCCESS;
+	if (mHeadless) {
+		// Offscreen images are ours, no need to ask (nor to wait) for them
+		imageIndex = acquireOffscreenImage();
+	} else {
+		// Query for the index of the next available image in the swapchain
+		// We also pass down async object to signal
+		result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX,
+			mImageAvailableSemaphores[mCurrentFrame], VK_NULL_HANDLE, &imageIndex);
+	}
 	// Check that the swapchain still matches this surface
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapChain();
@@ -161,7 +167,8 @@ void LoadModelApp::drawFrame() {
 	VkSemaphore waitSemaphores[] = { mImageAvailableSemaphores[mCurrentFrame] };
 	// At which stage to wait
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	// Offscreen there is no acquired image to wait for
+	submitInfo.waitSemaphoreCount = mHeadless ? 0 : 1;
 	// Indcies makes a correspondence between the two arrays
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
@@ -170,7 +177,8 @@ void LoadModelApp::drawFrame() {
 	submitInfo.pCommandBuffers = &mCommandBuffers[imageIndex];
 	// Set of conditions (again, only one) to signal once we finish
 	VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[mCurrentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	// (nobody presents offscreen, so nobody would wait on it)
+	submitInfo.signalSemaphoreCount = mHeadless ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	vkResetFences(mDevice, 1, &mInFlightFences[mCurrentFrame]);
@@ -179,6 +187,11 @@ void LoadModelApp::drawFrame() {
 	if (vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, mInFlightFences[mCurrentFrame]) != VK_SUCCESS) {
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
+	if (mHeadless) {
+		// The frame stays in the offscreen image
+		mCurrentFrame = (mCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		return;
+	}
 	// Prepare to present the frame
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
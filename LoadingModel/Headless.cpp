@@ -0,0 +1,59 @@
+#include <iostream>
+
+#include "LoadModelApp.h"
+
+void LoadModelApp::createOffscreenImages() {
+	// Stand in for the swapchain: same format and count the windowed mode would
+	// usually get, so the render pass and the per image resources do not change
+	mSwapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+	mSwapChainExtent = { mWidth, mHeight };
+	mSwapChainImages.resize(OFFSCREEN_IMAGE_COUNT);
+	mOffscreenMemories.resize(OFFSCREEN_IMAGE_COUNT);
+	for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; i++) {
+		// Transfer source too, to read the frames back
+		createImage(mWidth, mHeight, mSwapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mSwapChainImages[i], mOffscreenMemories[i]);
+	}
+	mOffscreenImage = 0;
+}
+
+void LoadModelApp::destroyOffscreenImages() {
+	for (size_t i = 0; i < mSwapChainImages.size(); i++) {
+		vkDestroyImage(mDevice, mSwapChainImages[i], nullptr);
+		vkFreeMemory(mDevice, mOffscreenMemories[i], nullptr);
+	}
+	mSwapChainImages.clear();
+	mOffscreenMemories.clear();
+}
+
+uint32_t LoadModelApp::acquireOffscreenImage() {
+	// Round robin, drawFrame still waits for the fence of the frame that used it last
+	uint32_t imageIndex = mOffscreenImage;
+	mOffscreenImage = (mOffscreenImage + 1) % OFFSCREEN_IMAGE_COUNT;
+	return imageIndex;
+}
+
+void LoadModelApp::logHeadlessDevice() {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	const char* type = "other";
+	switch (properties.deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		type = "discrete gpu";
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		type = "integrated gpu";
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		type = "virtual gpu";
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		type = "cpu";
+		break;
+	default:
+		break;
+	}
+	std::cout << "[headless] rendering " << mWidth << "x" << mHeight << " offscreen on "
+		<< properties.deviceName << " (" << type << ")" << std::endl;
+}
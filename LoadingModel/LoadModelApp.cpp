@@ -3,8 +3,14 @@
 #include "LoadModelApp.h"
 #include "DebugLog.h"
 
+LoadModelApp::LoadModelApp(bool headless, uint32_t frameCount) :
+	mHeadless(headless), mFrameCount(frameCount) {
+}
+
 void LoadModelApp::run() {
-	initWindow();
+	if (!mHeadless) {
+		initWindow();
+	}
 	initVulkan();
 	mainLoop();
 	cleanup();
@@ -30,8 +36,13 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
 void LoadModelApp::initVulkan() {
 	createInstance();
 	setupDebugMessenger();
-	createSurface();
+	if (!mHeadless) {
+		createSurface();
+	}
 	pickPhysicalDevice();
+	if (mHeadless) {
+		logHeadlessDevice();
+	}
 	createLogicalDevice();
 	createSwapChain();
 	createImageViews();
@@ -55,8 +66,18 @@ void LoadModelApp::initVulkan() {
 }
 
 void LoadModelApp::mainLoop() {
-	while (!glfwWindowShouldClose(mWindow)) {
-		glfwPollEvents();
+	// Without a window there is nothing to close, so stop after a while
+	uint32_t frameLimit = mFrameCount;
+	if (mHeadless && frameLimit == 0) {
+		frameLimit = HEADLESS_FRAME_COUNT;
+	}
+	for (uint32_t frame = 0; frameLimit == 0 || frame < frameLimit; frame++) {
+		if (!mHeadless) {
+			if (glfwWindowShouldClose(mWindow)) {
+				break;
+			}
+			glfwPollEvents();
+		}
 		drawFrame();
 	}
 
@@ -91,11 +112,15 @@ void LoadModelApp::cleanup() {
 		DestroyDebugUtilsMessengerEXT(mInstance, mDebugMessenger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+	if (!mHeadless) {
+		vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+	}
 	vkDestroyInstance(mInstance, nullptr);
 
-	glfwDestroyWindow(mWindow);
-	glfwTerminate();
+	if (!mHeadless) {
+		glfwDestroyWindow(mWindow);
+		glfwTerminate();
+	}
 }
 
 void LoadModelApp::createInstance() {
@@ -12,6 +12,7 @@
 
 class LoadModelApp {
 public:
+	explicit LoadModelApp(bool headless = false, uint32_t frameCount = 0);
 	void run();
 	bool mFramebufferResized{ false };
 private:
@@ -20,6 +21,14 @@ private:
 	const uint32_t mHeight{ 600 };
 	const std::string MODEL_PATH{ "models/viking_room.obj" };
 	const std::string TEXTURE_PATH{ "textures/viking_room.png" };
+	// Headless mode: offscreen images instead of a window, a surface and a swapchain
+	bool mHeadless{ false };
+	// Frames to render before exiting, 0 means until the window is closed
+	uint32_t mFrameCount{ 0 };
+	const uint32_t OFFSCREEN_IMAGE_COUNT{ 3 };
+	const uint32_t HEADLESS_FRAME_COUNT{ 300 };
+	std::vector<VkDeviceMemory> mOffscreenMemories;
+	uint32_t mOffscreenImage{ 0 };
 	// Model loading
 	std::vector<Vertex> mVertices;
 	std::vector<uint32_t> mIndices;
@@ -96,6 +105,11 @@ private:
 	void createSurface();
 	void createSwapChain();
 	void recreateSwapChain();
+	// Headless
+	void createOffscreenImages();
+	void destroyOffscreenImages();
+	uint32_t acquireOffscreenImage();
+	void logHeadlessDevice();
 	void cleanupSwapChain();
 	void createImageViews();
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
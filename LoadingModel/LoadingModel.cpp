@@ -1,11 +1,44 @@
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include <cstdlib>
 
 #include "LoadModelApp.h"
 
+// Only the two options of the headless mode, the rest of the sample is fixed
+static void printUsage(const std::string& program) {
+	std::cerr << "usage: " << program << " [options]\n"
+		<< "  --headless               render offscreen, no window (any device, even lavapipe)\n"
+		<< "  --frames <n>             frames to render before exiting (headless default 300)\n";
+}
+
 int main(int argc, char* argv[]) {
-	LoadModelApp app;
+	bool headless = false;
+	uint32_t frameCount = 0;
+	// Kept out of the loop to name it in the error (stoul only says "stoul")
+	std::string arg;
+	try {
+		for (int i = 1; i < argc; i++) {
+			arg = argv[i];
+			if (arg == "--headless") {
+				headless = true;
+			} else if (arg == "--frames" && i + 1 < argc) {
+				size_t used = 0;
+				frameCount = static_cast<uint32_t>(std::stoul(argv[++i], &used));
+				if (argv[i][used] != '\0') {
+					throw std::invalid_argument(arg);
+				}
+			} else {
+				throw std::invalid_argument(arg);
+			}
+		}
+	} catch (const std::logic_error&) {
+		std::cerr << "invalid option " << arg << "!" << std::endl;
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	LoadModelApp app(headless, frameCount);
 
 	try {
 		app.run();
@@ -16,4 +49,4 @@ int main(int argc, char* argv[]) {
 	}
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -235,8 +235,10 @@ void LoadModelApp::createRenderPass() {
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	// We do not care what was before (since we are going to clear)
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	// We do need to be able to use it the swapchan afetr render
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// We do need to be able to use it the swapchan afetr render, or to copy it
+	// out when rendering offscreen
+	colorAttachment.finalLayout = mHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL :
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	// Depth and stencil attachment
 	VkAttachmentDescription depthAttachment{};
@@ -55,17 +55,26 @@ void LoadModelApp::cleanupSwapChain() {
 		vkDestroyImageView(mDevice, mSwapChainImageViews[i], nullptr);
 	}
 
-	vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
-
+	// The uniforms go per image, release them before the offscreen images go away
 	for (size_t i = 0; i < mSwapChainImages.size(); i++) {
 		vkDestroyBuffer(mDevice, mUniformBuffers[i], nullptr);
 		vkFreeMemory(mDevice, mUniformBuffersMemory[i], nullptr);
 	}
 
 	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+
+	if (mHeadless) {
+		destroyOffscreenImages();
+	} else {
+		vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+	}
 }
 
 void LoadModelApp::createSwapChain() {
+	if (mHeadless) {
+		createOffscreenImages();
+		return;
+	}
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(mPhysicalDevice);
 	// We chose the best format, present mode and extent form all the available
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
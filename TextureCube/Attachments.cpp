@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "Attachments.h"
+#include "TextureCubeApp.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static double toMiB(VkDeviceSize bytes) {
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+VkDeviceSize layoutTransientAttachments(std::vector<TransientAttachment>& attachments) {
+	// A slot is a range of the block shared by attachments that are never alive at once
+	struct Slot {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		std::vector<size_t> members;
+	};
+	std::vector<Slot> slots;
+	VkDeviceSize blockSize = 0;
+
+	for (size_t i = 0; i < attachments.size(); i++) {
+		TransientAttachment& attachment = attachments[i];
+		const VkMemoryRequirements& requirements = attachment.requirements;
+		bool placed = false;
+		for (size_t s = 0; s < slots.size() && !placed; s++) {
+			Slot& slot = slots[s];
+			bool lastSlot = (s + 1 == slots.size());
+			// Only the last slot can grow without stepping over the next one
+			if (slot.offset % requirements.alignment != 0 ||
+				(requirements.size > slot.size && !lastSlot)) {
+				continue;
+			}
+			bool aliasable = true;
+			for (size_t member : slot.members) {
+				if (attachments[member].overlaps(attachment)) {
+					aliasable = false;
+					break;
+				}
+			}
+			if (aliasable) {
+				attachment.offset = slot.offset;
+				slot.size = std::max(slot.size, requirements.size);
+				slot.members.push_back(i);
+				blockSize = std::max(blockSize, slot.offset + slot.size);
+				placed = true;
+			}
+		}
+		// Nobody to share with, open a new slot at the end of the block
+		if (!placed) {
+			Slot slot{ alignUp(blockSize, requirements.alignment), requirements.size, { i } };
+			attachment.offset = slot.offset;
+			blockSize = slot.offset + slot.size;
+			slots.push_back(slot);
+		}
+	}
+
+	return blockSize;
+}
+
+void TextureCubeApp::createTransientAttachments() {
+	TRACE_FUNCTION();
+	// First the images (they are not bound to any memory yet)
+	createColorResources();
+	createDepthResources();
+	// Both are used by our only subpass, so they are alive at the same time
+	// and the layout will place them one after the other
+	std::vector<TransientAttachment> attachments = {
+		{ mColorImage, 0, 0 },
+		{ mDepthImage, 0, 0 }
+	};
+	allocateTransientMemory(attachments);
+	// The views can only be created once the memory is bound
+	mColorImageView = createImageView(mColorImage, mSwapChainImageFormat,
+		VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	mDepthImageView = createImageView(mDepthImage, findDepthFormat(),
+		VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+}
+
+void TextureCubeApp::allocateTransientMemory(std::vector<TransientAttachment>& attachments) {
+	// The block must come from a memory type all the attachments accept
+	uint32_t typeFilter = ~0u;
+	for (auto& attachment : attachments) {
+		vkGetImageMemoryRequirements(mDevice, attachment.image, &attachment.requirements);
+		typeFilter &= attachment.requirements.memoryTypeBits;
+	}
+	VkDeviceSize blockSize = layoutTransientAttachments(attachments);
+	// Prefer lazily allocated memory, on tilers it never gets committed since
+	// the attachments live only in tile memory. Otherwise plain device memory
+	std::optional<uint32_t> memoryType = findOptionalMemoryType(typeFilter,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+	mTransientMemoryLazy = memoryType.has_value();
+	if (!mTransientMemoryLazy) {
+		memoryType = findMemoryType(typeFilter, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	VkMemoryRequirements blockRequirements{};
+	blockRequirements.size = blockSize;
+	blockRequirements.alignment = 1;
+	blockRequirements.memoryTypeBits = 1u << memoryType.value();
+	mTransientMemory = allocateMemory(blockRequirements,
+		mMemProperties.memoryTypes[memoryType.value()].propertyFlags, MemoryCategory::Attachment);
+	mTransientMemorySize = blockSize;
+	// Every attachment takes its place inside the shared block
+	for (const auto& attachment : attachments) {
+		vkBindImageMemory(mDevice, attachment.image, mTransientMemory, attachment.offset);
+	}
+}
+
+void TextureCubeApp::reportAttachmentMemory() {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts &
+		properties.limits.framebufferDepthSampleCounts;
+	VkFormat depthFormat = findDepthFormat();
+
+	const std::vector<VkExtent2D> resolutions = {
+		mSwapChainExtent, { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 }
+	};
+
+	std::cout << "Transient attachment memory ("
+		<< (mTransientMemoryLazy ? "lazily allocated" : "device local") << ")" << std::endl;
+	std::cout << std::fixed << std::setprecision(1);
+	for (const auto& extent : resolutions) {
+		for (uint32_t samples = VK_SAMPLE_COUNT_1_BIT; samples <= VK_SAMPLE_COUNT_64_BIT; samples <<= 1) {
+			if (!(counts & samples)) {
+				continue;
+			}
+			// Probe images, only to ask the driver how big they would be
+			VkImage color, depth;
+			createImageObject(extent.width, extent.height, 1,
+				static_cast<VkSampleCountFlagBits>(samples), mSwapChainImageFormat,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, color);
+			createImageObject(extent.width, extent.height, 1,
+				static_cast<VkSampleCountFlagBits>(samples), depthFormat,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depth);
+			std::vector<TransientAttachment> attachments = { { color, 0, 0 }, { depth, 0, 0 } };
+			VkDeviceSize separate = 0;
+			for (auto& attachment : attachments) {
+				vkGetImageMemoryRequirements(mDevice, attachment.image, &attachment.requirements);
+				separate += attachment.requirements.size;
+			}
+			VkDeviceSize block = layoutTransientAttachments(attachments);
+			// Our only subpass uses both, so aliasing has nothing to share yet: the
+			// block is the two one after the other, plus the padding for the depth
+			// alignment. It only saves something with attachments that are not alive
+			// at once, with more subpasses
+			VkDeviceSize aliased = block < separate ? separate - block : 0;
+			// Lazy memory (ideally) never commits the block at all
+			VkDeviceSize lazy = mTransientMemoryLazy ? block : 0;
+
+			std::cout << "  " << extent.width << "x" << extent.height << " x" << samples
+				<< ": color " << toMiB(attachments[0].requirements.size) << " MiB"
+				<< ", depth " << toMiB(attachments[1].requirements.size) << " MiB"
+				<< ", block " << toMiB(block) << " MiB"
+				<< ", saved " << toMiB(aliased) << " MiB aliasing, " << toMiB(lazy) << " MiB lazy"
+				<< std::endl;
+
+			vkDestroyImage(mDevice, depth, mHostCallbacks);
+			vkDestroyImage(mDevice, color, mHostCallbacks);
+		}
+	}
+	// What the driver has really committed for the live attachments
+	VkDeviceSize committed = mTransientMemorySize;
+	if (mTransientMemoryLazy) {
+		vkGetDeviceMemoryCommitment(mDevice, mTransientMemory, &committed);
+	}
+	std::cout << "  current " << mSwapChainExtent.width << "x" << mSwapChainExtent.height
+		<< " x" << mMsaaSamples << ": block " << toMiB(mTransientMemorySize)
+		<< " MiB, committed " << toMiB(committed) << " MiB" << std::endl;
+	std::cout << std::defaultfloat;
+}
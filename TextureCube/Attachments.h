@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// An attachment whose content only lives inside the render pass
+// (MSAA color, depth), so it never needs to be backed by real memory
+// on tile based GPUs. The subpass range tells us its lifetime, two
+// attachments whose ranges do not overlap can share (alias) the same memory
+struct TransientAttachment {
+	VkImage image;
+	uint32_t firstSubpass;
+	uint32_t lastSubpass;
+	// Filled when the shared block is laid out
+	VkMemoryRequirements requirements;
+	VkDeviceSize offset;
+
+	inline bool overlaps(const TransientAttachment& other) const {
+		return firstSubpass <= other.lastSubpass && other.firstSubpass <= lastSubpass;
+	}
+};
+
+// Place the attachments inside one memory block. Every attachment goes
+// into the first slot where it does not overlap (in time) with any attachment
+// already there; otherwise a new slot is opened at the end of the block.
+// Returns the total size of the block
+VkDeviceSize layoutTransientAttachments(std::vector<TransientAttachment>& attachments);
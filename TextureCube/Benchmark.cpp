@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Uniforms.h"
+#include "TextureCubeApp.h"
+
+// Summary of a series of frame times, in milliseconds
+struct FrameTimeStats {
+	size_t count{ 0 };
+	double min{ 0.0 };
+	double mean{ 0.0 };
+	double p50{ 0.0 };
+	double p95{ 0.0 };
+	double p99{ 0.0 };
+};
+
+static FrameTimeStats summarizeFrameTimes(std::vector<double> times) {
+	FrameTimeStats stats;
+	if (times.empty()) {
+		return stats;
+	}
+	std::sort(times.begin(), times.end());
+	// Nearest rank, so every percentile is a frame that really happened
+	auto percentile = [&times](double p) {
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * times.size()));
+		return times[std::max(rank, size_t(1)) - 1];
+	};
+	stats.count = times.size();
+	stats.min = times.front();
+	for (double time : times) {
+		stats.mean += time;
+	}
+	stats.mean /= times.size();
+	stats.p50 = percentile(50.0);
+	stats.p95 = percentile(95.0);
+	stats.p99 = percentile(99.0);
+	return stats;
+}
+
+static void writeFrameTimeStats(std::ostream& out, const FrameTimeStats& stats) {
+	out << "{ \"frames\": " << stats.count << ", \"min\": " << stats.min
+		<< ", \"mean\": " << stats.mean << ", \"p50\": " << stats.p50
+		<< ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << " }";
+}
+
+// Quoted, with what JSON does not allow raw escaped: the device name comes from
+// the driver and the scope names from the code, neither is checked
+static void writeJsonString(std::ostream& out, const std::string& text) {
+	out << '"';
+	for (char c : text) {
+		switch (c) {
+		case '"':
+			out << "\\\"";
+			break;
+		case '\\':
+			out << "\\\\";
+			break;
+		case '\n':
+			out << "\\n";
+			break;
+		case '\r':
+			out << "\\r";
+			break;
+		case '\t':
+			out << "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+					<< static_cast<int>(c) << std::dec << std::setfill(' ');
+			} else {
+				out << c;
+			}
+			break;
+		}
+	}
+	out << '"';
+}
+
+static const char* drawModeName(DrawMode mode) {
+	switch (mode) {
+	case DrawMode::Instanced:
+		return "instanced";
+	case DrawMode::PerInstance:
+		return "per instance";
+	case DrawMode::CpuCulled:
+		return "cpu culled";
+	case DrawMode::GpuCulled:
+		return "gpu culled";
+	default:
+		return "unknown";
+	}
+}
+
+void TextureCubeApp::benchmarkRecording() {
+	const std::vector<uint32_t> drawCounts = { 10000, 25000, 50000, 100000 };
+	const int WARMUP_ITERATIONS = 3;
+	const int ITERATIONS = 20;
+	// Powers of two up to every recording thread we have
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < mRecordThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(mRecordThreads);
+
+	// Nothing is submitted, the buffers are only recorded and thrown away. The
+	// draws still go through the render queue, so they need real instances
+	resizeInstances(drawCounts.back());
+	FrameContext& frame = mFrames[0];
+
+	std::cout << "[benchmark] command recording, " << ITERATIONS << " frames per run" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(10) << "draws" << std::setw(12) << "ms/frame"
+		<< std::setw(14) << "Mdraws/s" << std::setw(10) << "speedup" << std::endl;
+	std::vector<double> singleThreadMs(drawCounts.size(), 0.0);
+	for (uint32_t threads : threadCounts) {
+		for (size_t i = 0; i < drawCounts.size(); i++) {
+			uint32_t draws = drawCounts[i];
+			for (int j = 0; j < WARMUP_ITERATIONS; j++) {
+				resetFrameCommands(frame);
+				recordCommandBuffer(frame, 0, draws, threads, DrawMode::PerInstance);
+			}
+			auto start = std::chrono::steady_clock::now();
+			for (int j = 0; j < ITERATIONS; j++) {
+				resetFrameCommands(frame);
+				recordCommandBuffer(frame, 0, draws, threads, DrawMode::PerInstance);
+			}
+			auto end = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(end - start).count() / ITERATIONS;
+			if (threads == 1) {
+				singleThreadMs[i] = ms;
+			}
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(8) << threads << std::setw(10) << draws << std::setw(12) << ms
+				<< std::setw(14) << draws / (ms * 1000.0)
+				<< std::setw(10) << std::setprecision(2) << singleThreadMs[i] / ms
+				<< std::defaultfloat << std::endl;
+		}
+	}
+	resetFrameCommands(frame);
+}
+
+void TextureCubeApp::benchmarkInstancing() {
+	const std::vector<uint32_t> instanceCounts = { 1000, 10000, 100000, 250000, 1000000 };
+	// One draw per instance gets too slow to be worth measuring past this
+	const uint32_t MAX_PER_DRAW_INSTANCES = 100000;
+	const int WARMUP_FRAMES = 10;
+	const int FRAMES = 100;
+	// Renders the given frames and returns the average time of each one
+	auto timeFrames = [this, WARMUP_FRAMES, FRAMES]() {
+		for (int i = 0; i < WARMUP_FRAMES; i++) {
+			pollEvents();
+			drawFrame();
+		}
+		vkDeviceWaitIdle(mDevice);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < FRAMES; i++) {
+			pollEvents();
+			drawFrame();
+		}
+		// Count the GPU work too, not only the submission
+		vkDeviceWaitIdle(mDevice);
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+	};
+
+	std::cout << "[benchmark] frame time versus instance count, " << FRAMES
+		<< " frames per run (capped by the refresh rate without a mailbox present mode)"
+		<< std::endl;
+	std::cout << std::setw(10) << "instances" << std::setw(16) << "instanced ms"
+		<< std::setw(16) << "per draw ms" << std::setw(16) << "gpu culled ms" << std::endl;
+	DrawMode drawMode = mDrawMode;
+	for (uint32_t count : instanceCounts) {
+		resizeInstances(count);
+
+		mDrawMode = DrawMode::Instanced;
+		double instancedMs = timeFrames();
+		std::cout << std::fixed << std::setprecision(3) << std::setw(10) << count
+			<< std::setw(16) << instancedMs;
+		if (count <= MAX_PER_DRAW_INSTANCES) {
+			mDrawMode = DrawMode::PerInstance;
+			std::cout << std::setw(16) << timeFrames();
+		} else {
+			std::cout << std::setw(16) << "-";
+		}
+		// Only when the culling resources were created (--gpu-culling)
+		if (mGpuCulling) {
+			mDrawMode = DrawMode::GpuCulled;
+			std::cout << std::setw(16) << timeFrames();
+		} else {
+			std::cout << std::setw(16) << "-";
+		}
+		std::cout << std::defaultfloat << std::endl;
+	}
+	mDrawMode = drawMode;
+}
+
+void TextureCubeApp::benchmarkCulling() {
+	const uint32_t OBJECT_COUNT = 1000000;
+	const int ITERATIONS = 50;
+	// Random spheres in a big box, the camera sees part of it
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> size(0.01f, 0.1f);
+	std::vector<glm::vec4> spheres(OBJECT_COUNT);
+	for (auto& sphere : spheres) {
+		sphere = glm::vec4(position(generator), position(generator), position(generator),
+			size(generator));
+	}
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 30.0f);
+	proj[1][1] *= -1;
+	Frustum frustum = Frustum::fromMatrix(proj * view);
+
+	// The boxes around the same spheres, they go through the p-vertex test
+	std::vector<Aabb> boxes(OBJECT_COUNT);
+	for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+		glm::vec3 center = glm::vec3(spheres[i]);
+		boxes[i] = { center - glm::vec3(spheres[i].w), center + glm::vec3(spheres[i].w) };
+	}
+
+	FrustumCuller culler;
+	for (bool useBoxes : { false, true }) {
+		const char* shape = useBoxes ? "boxes" : "spheres";
+		if (useBoxes) {
+			culler.setBoxes(boxes);
+		} else {
+			culler.setSpheres(spheres);
+		}
+		// Every path has to give the same list as the plain loop
+		std::vector<uint32_t> reference;
+		culler.setPath(FrustumCuller::Path::Scalar);
+		culler.cull(frustum, reference);
+
+		std::cout << "[benchmark] cpu culling of " << OBJECT_COUNT << " " << shape << ", "
+			<< reference.size() << " visible, " << ITERATIONS << " runs each" << std::endl;
+		std::cout << std::setw(8) << "path" << std::setw(9) << "threads" << std::setw(12) << "ms"
+			<< std::setw(14) << "Mobjects/s" << std::setw(10) << "result" << std::endl;
+		std::vector<uint32_t> visible;
+		for (auto path : { FrustumCuller::Path::Scalar, FrustumCuller::Path::SSE, FrustumCuller::Path::AVX2 }) {
+			if (!culler.setPath(path)) {
+				std::cout << std::setw(8) << FrustumCuller::pathName(path) << "  not supported" << std::endl;
+				continue;
+			}
+			for (uint32_t threads : { 1u, mRecordThreads }) {
+				ThreadPool* pool = threads > 1 ? mThreadPool.get() : nullptr;
+				culler.cull(frustum, visible, pool);
+				auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < ITERATIONS; i++) {
+					culler.cull(frustum, visible, pool);
+				}
+				auto end = std::chrono::steady_clock::now();
+				double ms = std::chrono::duration<double, std::milli>(end - start).count() / ITERATIONS;
+				std::cout << std::fixed << std::setprecision(3)
+					<< std::setw(8) << FrustumCuller::pathName(path) << std::setw(9) << threads
+					<< std::setw(12) << ms << std::setw(14) << OBJECT_COUNT / (ms * 1000.0)
+					<< std::setw(10) << (visible == reference ? "ok" : "MISMATCH")
+					<< std::defaultfloat << std::endl;
+				if (threads == mRecordThreads) {
+					break;
+				}
+			}
+		}
+	}
+}
+
+void TextureCubeApp::benchmarkResize() {
+	// Like dragging the corner of the window: a new size every frame
+	const int WARMUP_RESIZES = 5;
+	const int RESIZES = 100;
+	std::cout << "[benchmark] resize storm, " << RESIZES << " resizes per run" << std::endl;
+	std::cout << std::setw(14) << "rebuild" << std::setw(12) << "avg ms" << std::setw(12) << "max ms"
+		<< std::setw(12) << "pipelines" << std::endl;
+	for (bool rebuildAll : { false, true }) {
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+		SwapChainStats before;
+		for (int i = -WARMUP_RESIZES; i < RESIZES; i++) {
+			if (i == 0) {
+				before = mSwapChainStats;
+			}
+			int step = (i + WARMUP_RESIZES) % 20;
+			glfwSetWindowSize(mWindow, static_cast<int>(mWidth) + 8 * step,
+				static_cast<int>(mHeight) + 6 * step);
+			glfwPollEvents();
+			auto start = std::chrono::steady_clock::now();
+			recreateSwapChain(rebuildAll);
+			auto end = std::chrono::steady_clock::now();
+			// Already handled, do not let the frame recreate it again
+			mFramebufferResized = false;
+			drawFrame();
+			if (i < 0) {
+				continue;
+			}
+			double ms = std::chrono::duration<double, std::milli>(end - start).count();
+			totalMs += ms;
+			maxMs = std::max(maxMs, ms);
+		}
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(14) << (rebuildAll ? "everything" : "size only")
+			<< std::setw(12) << totalMs / RESIZES << std::setw(12) << maxMs
+			<< std::setw(12) << mSwapChainStats.pipelineRebuilds - before.pipelineRebuilds
+			<< std::defaultfloat << std::endl;
+	}
+	glfwSetWindowSize(mWindow, static_cast<int>(mWidth), static_cast<int>(mHeight));
+	vkDeviceWaitIdle(mDevice);
+}
+
+void TextureCubeApp::scriptCamera(float time) {
+	// Stands in for the mouse: a drag from the centre that goes around a circle
+	// every 8 seconds, while the zoom goes in and out every 10
+	const float TAU = 6.28318f;
+	glm::vec2 center = glm::vec2(mTrackball.getWindowSize()) * 0.5f;
+	float radius = center.y * 0.5f;
+	float angle = time * TAU / 8.0f;
+	mTrackball.resetRotation();
+	mTrackball.startDrag(center);
+	mTrackball.drag(center + radius * glm::vec2(std::cos(angle), std::sin(angle)));
+	mTrackball.endDrag();
+	mZoomLevel = static_cast<int>(std::round(5.0f * std::sin(time * TAU / 10.0f)));
+}
+
+void TextureCubeApp::benchmarkFrames() {
+	const int WARMUP_FRAMES = 30;
+	const uint32_t DEFAULT_FRAMES = 600;
+	const float TIME_STEP = 1.0f / 60.0f;
+	uint32_t frames = mOptions.frameCount > 0 ? mOptions.frameCount : DEFAULT_FRAMES;
+
+	// The scene only depends on the frame number, not on how fast we render it,
+	// so two runs (or two commits) draw exactly the same frames
+	mFixedTimeStep = TIME_STEP;
+	std::vector<double> cpuTimes;
+	std::vector<double> gpuTimes;
+	// From the start of a frame until the CPU sees it done, the other side of more frames in flight
+	std::vector<double> latencies;
+	// And every scope of the frame, by name
+	std::map<std::string, std::vector<double>> scopeTimes;
+	cpuTimes.reserve(frames);
+	gpuTimes.reserve(frames);
+	latencies.reserve(frames);
+	uint64_t firstFrame = 0;
+	// The GPU time of a frame is known once the timeline reaches it, frames later
+	auto collectGpuTime = [&gpuTimes, &scopeTimes, &firstFrame](const FrameContext& frame) {
+		if (frame.gpuTimeMs < 0.0 || frame.gpuTimeFrame < firstFrame) {
+			return;
+		}
+		gpuTimes.push_back(frame.gpuTimeMs);
+		for (const auto& scope : frame.gpuScopes) {
+			if (scope.name != "frame") {
+				scopeTimes[scope.name].push_back(scope.ms);
+			}
+		}
+	};
+	for (int i = -WARMUP_FRAMES; i < static_cast<int>(frames); i++) {
+		if (i == 0) {
+			// Start the measured frames from the beginning of the script
+			vkDeviceWaitIdle(mDevice);
+			firstFrame = mFrameNumber;
+		}
+		mSimulationTime = std::max(i, 0) * TIME_STEP;
+		scriptCamera(mSimulationTime);
+		pollEvents();
+		size_t frameSlot = mCurrentFrame;
+		auto start = std::chrono::steady_clock::now();
+		drawFrame();
+		auto end = std::chrono::steady_clock::now();
+		if (i < 0) {
+			continue;
+		}
+		cpuTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		collectGpuTime(mFrames[frameSlot]);
+		// Any frame the timeline went past since the last one, each taken once
+		for (auto& frame : mFrames) {
+			if (frame.latencyMs >= 0.0 && frame.latencyFrame >= firstFrame) {
+				latencies.push_back(frame.latencyMs);
+			}
+			frame.latencyMs = -1.0;
+		}
+	}
+	// The last frames are still on the GPU. Their latency would include the
+	// wait for the device, so only their GPU times are kept
+	vkDeviceWaitIdle(mDevice);
+	for (size_t i = 0; i < mFrames.size(); i++) {
+		FrameContext& frame = mFrames[(mCurrentFrame + i) % mFrames.size()];
+		collectFrameTimes(frame);
+		collectGpuTime(frame);
+	}
+	mFixedTimeStep = 0.0f;
+
+	FrameTimeStats cpu = summarizeFrameTimes(cpuTimes);
+	FrameTimeStats gpu = summarizeFrameTimes(gpuTimes);
+	FrameTimeStats latency = summarizeFrameTimes(latencies);
+	std::cout << "[benchmark] " << frames << " scripted frames, " << mInstances.size()
+		<< " instances, " << drawModeName(mDrawMode) << ", " << mFrames.size()
+		<< " frames in flight" << std::endl;
+	std::cout << std::setw(14) << "" << std::setw(10) << "min" << std::setw(10) << "mean"
+		<< std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << std::endl;
+	auto printStats = [](const char* name, const FrameTimeStats& stats) {
+		std::cout << std::fixed << std::setprecision(3) << std::setw(14) << name;
+		if (stats.count == 0) {
+			std::cout << std::setw(10) << "-";
+		} else {
+			std::cout << std::setw(10) << stats.min << std::setw(10) << stats.mean
+				<< std::setw(10) << stats.p50 << std::setw(10) << stats.p95
+				<< std::setw(10) << stats.p99;
+		}
+		std::cout << std::defaultfloat << std::endl;
+	};
+	printStats("cpu", cpu);
+	printStats("gpu", gpu);
+	printStats("latency", latency);
+	std::map<std::string, FrameTimeStats> scopes;
+	for (const auto& scope : scopeTimes) {
+		scopes[scope.first] = summarizeFrameTimes(scope.second);
+		printStats(("  " + scope.first).c_str(), scopes[scope.first]);
+	}
+
+	// Everything that changes the numbers goes with them, so the files can be compared
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	std::ofstream out(mOptions.benchmarkOutput);
+	if (!out) {
+		throw std::runtime_error("failed to open " + mOptions.benchmarkOutput + "!");
+	}
+	out << std::setprecision(6) << "{\n  \"device\": ";
+	writeJsonString(out, properties.deviceName);
+	out << ",\n"
+		<< "  \"headless\": " << (mHeadless ? "true" : "false") << ",\n"
+		<< "  \"width\": " << mSwapChainExtent.width << ",\n"
+		<< "  \"height\": " << mSwapChainExtent.height << ",\n"
+		<< "  \"instances\": " << mInstances.size() << ",\n"
+		<< "  \"drawMode\": ";
+	writeJsonString(out, drawModeName(mDrawMode));
+	out << ",\n"
+		<< "  \"framesInFlight\": " << mFrames.size() << ",\n"
+		<< "  \"timeStep\": " << TIME_STEP << ",\n"
+		<< "  \"frames\": " << frames << ",\n"
+		<< "  \"cpuMs\": ";
+	writeFrameTimeStats(out, cpu);
+	out << ",\n  \"gpuMs\": ";
+	if (gpu.count == 0) {
+		// The graphics queue can not write timestamps
+		out << "null";
+	} else {
+		writeFrameTimeStats(out, gpu);
+	}
+	out << ",\n  \"latencyMs\": ";
+	writeFrameTimeStats(out, latency);
+	out << ",\n  \"gpuScopesMs\": {";
+	for (auto it = scopes.begin(); it != scopes.end(); ++it) {
+		out << (it == scopes.begin() ? "\n" : ",\n") << "    ";
+		writeJsonString(out, it->first);
+		out << ": ";
+		writeFrameTimeStats(out, it->second);
+	}
+	out << (scopes.empty() ? "}" : "\n  }");
+	// The uploads happen at startup, once, so they only have their totals
+	out << ",\n  \"uploadsMs\": {";
+	bool firstUpload = true;
+	for (const GpuProfiler* profiler : { mTransferProfiler.get(), mUploadProfiler.get() }) {
+		for (const auto& scope : profiler->totals()) {
+			out << (firstUpload ? "\n" : ",\n") << "    ";
+			writeJsonString(out, scope.first);
+			out << ": { \"batches\": "
+				<< scope.second.count << ", \"total\": " << scope.second.totalMs
+				<< ", \"max\": " << scope.second.maxMs << " }";
+			firstUpload = false;
+		}
+	}
+	out << (firstUpload ? "}" : "\n  }");
+	out << "\n}\n";
+	std::cout << "[benchmark] results written to " << mOptions.benchmarkOutput << std::endl;
+}
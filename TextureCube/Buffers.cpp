@@ -1,53 +1,7 @@
 #include "Vertex.h"
 #include "TextureCubeApp.h"
 
-void TextureCubeApp::createVertexBuffer() {
-	VkDeviceSize bufferSize = sizeof(mVertices[0]) * mVertices.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			stagingBuffer, stagingBufferMemory);
-	// Fill the vertex buffer with the data
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, mVertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(mDevice, stagingBufferMemory);
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mVertexBuffer, mVertexBufferMemory);
-	// Copy the stagging buffer (which is on host shared mem) into the Vertex buffer 
-	// (which is on device vid mem)
-	copyBuffer(stagingBuffer, mVertexBuffer, bufferSize);
-	// Destory the stagging buffer (we do not need it anymore)
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-}
-
-void TextureCubeApp::createIndexBuffer() {
-	VkDeviceSize bufferSize = sizeof(mIndices[0]) * mIndices.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
-	// Fill the vertex buffer with the data
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, mIndices.data(), (size_t)bufferSize);
-	vkUnmapMemory(mDevice, stagingBufferMemory);
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mIndexBuffer, mIndexBufferMemory);
-	// Copy the stagging buffer (which is on host shared mem) into the Vertex buffer 
-	// (which is on device vid mem)
-	copyBuffer(stagingBuffer, mIndexBuffer, bufferSize);
-	// Destory the stagging buffer (we do not need it anymore)
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-}
-
-void TextureCubeApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+void TextureCubeApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, MemoryCategory category) {
 	// Prepare the buffer creation
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -55,68 +9,27 @@ void TextureCubeApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, V
 	bufferInfo.usage = usage;
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	// Create buffer
-	if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+	if (vkCreateBuffer(mDevice, &bufferInfo, mHostCallbacks, &buffer) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create buffer!");
 	}
 	// Query the mem requieriments
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
-	// Prepare to allocate the mem
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-	// Allocate memmory
-	if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
-	}
+	// Allocate memmory (within the heap's budget)
+	bufferMemory = allocateMemory(memRequirements, properties, category);
 	// Bind the buffer and his memmory
 	vkBindBufferMemory(mDevice, buffer, bufferMemory, 0);
 }
 
-uint32_t TextureCubeApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-	
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memProperties);
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if (  typeFilter & (1 << i) && 
-			  (memProperties.memoryTypes[i].propertyFlags & properties) == properties
-		   ) {
-			return i;
-		}
-	}
-
-	throw std::runtime_error("failed to find suitable memory type!");
-}
-
-void TextureCubeApp::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-	// Copies are command submitted to queues, so we need to create a command buffer
-	// to copy buffers
-	// Create command buffer
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-	// Only one command the copy operation
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0; // Optional
-	copyRegion.dstOffset = 0; // Optional
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-	// Finish the command buffer
-	endSingleTimeCommands(commandBuffer);
-}
-
 void TextureCubeApp::createDepthResources() {
 	// Query the best depth format available
 	VkFormat depthFormat = findDepthFormat();
-	// Create image 
-	createImage(mSwapChainExtent.width, mSwapChainExtent.height, 1, mMsaaSamples, 
-		depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mDepthImage, mDepthImageMemory);
-	// Now view
-	mDepthImageView = createImageView(mDepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-	// Transition to an depth/stencil buffer (optional in our case)
-	transitionImageLayout(mDepthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, 
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+	// Create image, the depth is never stored (DONT_CARE) so it is transient.
+	// Its memory and view come from createTransientAttachments
+	createImageObject(mSwapChainExtent.width, mSwapChainExtent.height, 1, mMsaaSamples, 
+		depthFormat, VK_IMAGE_TILING_OPTIMAL, 
+		VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
+		mDepthImage);
 }
 
 VkFormat TextureCubeApp::findSupportedFormat(const std::vector<VkFormat>& candidates,
@@ -177,10 +90,9 @@ VkSampleCountFlagBits TextureCubeApp::getMaxUsableSampleCount() {
 
 void TextureCubeApp::createColorResources() {
 	VkFormat colorFormat = mSwapChainImageFormat;
-
-	createImage(mSwapChainExtent.width, mSwapChainExtent.height, 1, mMsaaSamples, colorFormat, 
+	// Only the resolved image survives the render pass, so this one is transient.
+	// Its memory and view come from createTransientAttachments
+	createImageObject(mSwapChainExtent.width, mSwapChainExtent.height, 1, mMsaaSamples, colorFormat, 
 			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mColorImage, mColorImageMemory);
-
-	mColorImageView = createImageView(mColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+			mColorImage);
 }
@@ -0,0 +1,43 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Culling.h"
+
+Frustum Frustum::fromMatrix(const glm::mat4& matrix) {
+	// GLM is column major, matrix[column][row]
+	auto row = [&matrix](int i) {
+		return glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+	};
+	// A clip position is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w
+	Frustum frustum;
+	frustum.planes[0] = row(3) + row(0); // left
+	frustum.planes[1] = row(3) - row(0); // right
+	frustum.planes[2] = row(3) + row(1); // bottom
+	frustum.planes[3] = row(3) - row(1); // top
+	frustum.planes[4] = row(2);          // near
+	frustum.planes[5] = row(3) - row(2); // far
+	// Normalized, so the plane equation gives real distances to compare with a radius
+	for (auto& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec4& sphere) const {
+	for (const auto& plane : planes) {
+		if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+			return false;
+		}
+	}
+	return true;
+}
+
+float Frustum::sphereMargin(const glm::vec4& sphere) const {
+	float margin = std::numeric_limits<float>::max();
+	for (const auto& plane : planes) {
+		float distance = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w + sphere.w;
+		margin = std::min(margin, std::abs(distance));
+	}
+	return margin;
+}
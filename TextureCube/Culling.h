@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// The six planes of a view frustum, with the normals pointing inside. A
+// point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+	std::array<glm::vec4, 6> planes;
+
+	// Extracts the planes from a model-view-projection matrix (Vulkan clip
+	// space, depth from 0 to 1), they end up in the space of the model
+	static Frustum fromMatrix(const glm::mat4& matrix);
+	// Spheres are packed as center (xyz) and radius (w)
+	bool intersectsSphere(const glm::vec4& sphere) const;
+	// How far the sphere is from crossing any plane, a small value means
+	// that rounding could put it on either side
+	float sphereMargin(const glm::vec4& sphere) const;
+};
+
+// Axis aligned box, by its two opposite corners
+struct Aabb {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// What the culling compute shader receives every frame (see shaders/cull.comp)
+struct CullingPushConstants {
+	glm::vec4 planes[6];
+	uint32_t objectCount;
+	// Range of the mesh in the geometry pool
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+};
@@ -4,6 +4,7 @@
 #include "DebugLog.h"
 
 void TextureCubeApp::setupDebugMessenger() {
+	TRACE_FUNCTION();
 	if (!mEnableValidationLayers) {
 		return;
 	}
@@ -11,7 +12,7 @@ void TextureCubeApp::setupDebugMessenger() {
 	VkDebugUtilsMessengerCreateInfoEXT createInfo{};
 	populateDebugMessengerCreateInfo(createInfo);
 
-	if (CreateDebugUtilsMessengerEXT(mInstance, &createInfo, nullptr, &mDebugMessenger) != VK_SUCCESS) {
+	if (CreateDebugUtilsMessengerEXT(mInstance, &createInfo, mHostCallbacks, &mDebugMessenger) != VK_SUCCESS) {
 		throw std::runtime_error("failed to set up debug messenger!");
 	}
 }
@@ -37,16 +38,17 @@ void TextureCubeApp::populateDebugMessengerCreateInfo(
 		VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
 	
 	createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-	createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+	// The callback ignores the verbose ones, so do not even ask for them
+	createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
 	createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
 	createInfo.pfnUserCallback = debugCallback;
-	createInfo.pUserData = nullptr; // Optional
+	// Null before the logger exists, then the callback prints by itself
+	createInfo.pUserData = mDebugLogger.get();
 }
 
 
 std::string debugMgsg2str(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-	VkDebugUtilsMessageTypeFlagsEXT messageType,
-	const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData) {
+	VkDebugUtilsMessageTypeFlagsEXT messageType, const char* message) {
 
 	std::string str;
 
@@ -81,7 +83,7 @@ std::string debugMgsg2str(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity
 	}
 	str.append("\n  ");
 
-	str.append(pCallbackData->pMessage);
+	str.append(message);
 	str.append("\n");
 
 	return str;
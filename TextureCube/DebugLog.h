@@ -6,8 +6,7 @@
 #include "TextureCubeApp.h"
 
 std::string debugMgsg2str(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-	VkDebugUtilsMessageTypeFlagsEXT messageType,
-	const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData);
+	VkDebugUtilsMessageTypeFlagsEXT messageType, const char* message);
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -17,8 +16,13 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 
 	if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
 		// Message is important enough to show
-		std::cerr << "Validation layer" << std::endl;
-		std::cerr << debugMgsg2str(messageSeverity, messageType, pCallbackData) << std::endl;
+		if (pUserData != nullptr) {
+			// The logger thread formats and prints it, so the driver call returns right away
+			static_cast<DebugLogger*>(pUserData)->push(messageSeverity, messageType, pCallbackData);
+		} else {
+			std::cerr << "Validation layer" << std::endl;
+			std::cerr << debugMgsg2str(messageSeverity, messageType, pCallbackData->pMessage) << std::endl;
+		}
 	}
 
 	return VK_FALSE;
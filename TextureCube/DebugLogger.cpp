@@ -0,0 +1,150 @@
+#include <iostream>
+#include <sstream>
+
+#include "DebugLog.h"
+#include "DebugLogger.h"
+
+// Messages waiting in the queue, past this the callback drops them
+static constexpr uint32_t MAX_PENDING_MESSAGES = 4096;
+// New message ids printed per second, the rest are only counted
+static constexpr uint32_t MAX_MESSAGES_PER_SECOND = 20;
+static constexpr auto DRAIN_PERIOD = std::chrono::milliseconds(10);
+static constexpr auto SUMMARY_PERIOD = std::chrono::seconds(5);
+
+DebugLogger::DebugLogger() : m_head(&m_stub), m_tail(&m_stub),
+	m_lineBudget(MAX_MESSAGES_PER_SECOND) {
+
+	m_lastRefill = std::chrono::steady_clock::now();
+	m_lastSummary = m_lastRefill;
+	m_thread = std::thread(&DebugLogger::loggerLoop, this);
+}
+
+DebugLogger::~DebugLogger() {
+	m_stop = true;
+	m_thread.join();
+}
+
+void DebugLogger::push(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+	VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* callbackData) {
+
+	if (m_pending.fetch_add(1, std::memory_order_relaxed) >= MAX_PENDING_MESSAGES) {
+		m_pending.fetch_sub(1, std::memory_order_relaxed);
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	// The callback data only lives during the callback, so copy what we need
+	Node* node = new Node;
+	node->message.severity = severity;
+	node->message.type = type;
+	node->message.idNumber = callbackData->messageIdNumber;
+	node->message.idName = callbackData->pMessageIdName != nullptr ? callbackData->pMessageIdName : "";
+	node->message.text = callbackData->pMessage != nullptr ? callbackData->pMessage : "";
+	enqueue(node);
+}
+
+void DebugLogger::enqueue(Node* node) {
+	node->next.store(nullptr, std::memory_order_relaxed);
+	// Take the head, then link the previous one to us. Between the two steps the
+	// consumer sees the queue as cut at the previous node and simply tries later
+	Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+	previous->next.store(node, std::memory_order_release);
+}
+
+DebugLogger::Node* DebugLogger::dequeue() {
+	Node* tail = m_tail;
+	Node* next = tail->next.load(std::memory_order_acquire);
+	if (tail == &m_stub) {
+		// The stub carries no message, skip it
+		if (next == nullptr) {
+			return nullptr;
+		}
+		m_tail = next;
+		tail = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	if (next != nullptr) {
+		m_tail = next;
+		return tail;
+	}
+	// The tail is the last node, or a producer is still linking the next one
+	if (tail != m_head.load(std::memory_order_acquire)) {
+		return nullptr;
+	}
+	// Put the stub behind the last node, so that one can be taken out
+	enqueue(&m_stub);
+	next = tail->next.load(std::memory_order_acquire);
+	if (next != nullptr) {
+		m_tail = next;
+		return tail;
+	}
+	return nullptr;
+}
+
+void DebugLogger::loggerLoop() {
+	while (!m_stop) {
+		drain();
+		auto now = std::chrono::steady_clock::now();
+		if (now - m_lastSummary > SUMMARY_PERIOD) {
+			printRepeats();
+			m_lastSummary = now;
+		}
+		std::this_thread::sleep_for(DRAIN_PERIOD);
+	}
+	// Whatever came in before the messenger was destroyed
+	drain();
+	printRepeats();
+	uint64_t dropped = m_dropped.load();
+	if (dropped > 0 || m_rateLimited > 0) {
+		std::cerr << "[validation] " << dropped << " messages dropped (queue full), "
+			<< m_rateLimited << " not printed (rate limit)" << std::endl;
+	}
+}
+
+void DebugLogger::drain() {
+	auto now = std::chrono::steady_clock::now();
+	if (now - m_lastRefill > std::chrono::seconds(1)) {
+		m_lineBudget = MAX_MESSAGES_PER_SECOND;
+		m_lastRefill = now;
+	}
+	// Everything goes out in one write, so it does not mix with the other logs
+	std::ostringstream out;
+	while (Node* node = dequeue()) {
+		m_pending.fetch_sub(1, std::memory_order_relaxed);
+		const Message& message = node->message;
+		// Some messages have no id, then the text itself tells them apart
+		const std::string& key = message.idName.empty() ? message.text : message.idName;
+		Seen& seen = m_seen[key];
+		seen.count++;
+		if (seen.count == 1) {
+			if (m_lineBudget > 0) {
+				m_lineBudget--;
+				out << "Validation layer\n" << debugMgsg2str(message.severity, message.type,
+					message.text.c_str()) << "\n";
+			} else {
+				m_rateLimited++;
+			}
+			// Only the repeats after this one go to the summaries
+			seen.reported = 1;
+		}
+		delete node;
+	}
+	std::string text = out.str();
+	if (!text.empty()) {
+		std::cerr << text << std::flush;
+	}
+}
+
+void DebugLogger::printRepeats() {
+	std::ostringstream out;
+	for (auto& seen : m_seen) {
+		if (seen.second.count > seen.second.reported) {
+			out << "[validation] " << seen.first.substr(0, 120) << " repeated "
+				<< seen.second.count - seen.second.reported << " more times\n";
+			seen.second.reported = seen.second.count;
+		}
+	}
+	std::string text = out.str();
+	if (!text.empty()) {
+		std::cerr << text << std::flush;
+	}
+}
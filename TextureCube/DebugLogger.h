@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+//! Prints the validation messages on its own thread, once per message id
+/*!
+  The debug callback runs inside the driver call that triggered it, often on
+  the recording threads and every frame. It only copies the message into a
+  lock free queue (many producers, one consumer) and returns. The thread of
+  the logger drains the queue a few times per second. It prints the first
+  message of every id and only counts the repeats, printing a summary of them
+  now and then. New ids are also rate limited, and the queue has a cap, so a
+  flood of messages can not take the app down with it.
+*/
+class DebugLogger {
+public:
+	//! A validation message, copied out of the callback
+	struct Message {
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+		VkDebugUtilsMessageTypeFlagsEXT type;
+		int32_t idNumber;
+		std::string idName;
+		std::string text;
+	};
+	//! Starts the logging thread
+	DebugLogger();
+	//! Prints what is still queued, the summary of the repeats, and joins the thread
+	~DebugLogger();
+	DebugLogger(const DebugLogger&) = delete;
+	DebugLogger& operator=(const DebugLogger&) = delete;
+	//! Queues a message, never blocks. Safe to call from any thread
+	void push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+		const VkDebugUtilsMessengerCallbackDataEXT* callbackData);
+
+protected:
+	struct Node {
+		std::atomic<Node*> next{ nullptr };
+		Message message;
+	};
+	//! What we know of every message id seen so far
+	struct Seen {
+		uint64_t count{ 0 };
+		//! Count the last summary printed
+		uint64_t reported{ 0 };
+	};
+	//! Links a node at the head of the queue (the producer side)
+	void enqueue(Node* node);
+	//! Unlinks the oldest node, null if the queue is empty (only the logging thread)
+	Node* dequeue();
+	//! What the logging thread runs until the logger is destroyed
+	void loggerLoop();
+	//! Prints or counts everything in the queue
+	void drain();
+	void printRepeats();
+	//! Producers swap themselves in at the head, the consumer walks from the tail
+	std::atomic<Node*> m_head;
+	Node* m_tail;
+	//! Keeps the queue from ever being empty of nodes
+	Node m_stub;
+	//! Queued messages, beyond the cap new ones are dropped
+	std::atomic<uint32_t> m_pending{ 0 };
+	std::atomic<uint64_t> m_dropped{ 0 };
+	// From here on, only the logging thread touches them
+	std::unordered_map<std::string, Seen> m_seen;
+	//! New messages that can still be printed this second
+	uint32_t m_lineBudget;
+	uint64_t m_rateLimited{ 0 };
+	std::chrono::steady_clock::time_point m_lastRefill;
+	std::chrono::steady_clock::time_point m_lastSummary;
+	std::atomic<bool> m_stop{ false };
+	//! Started last, once everything else is ready
+	std::thread m_thread;
+};
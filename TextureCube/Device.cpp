@@ -6,6 +6,7 @@
 #include "Device.h"
 
 void TextureCubeApp::pickPhysicalDevice() {
+	TRACE_FUNCTION();
 	// Query the number of vulkan supported GPU's
 	uint32_t deviceCount = 0;
 	vkEnumeratePhysicalDevices(mInstance, &deviceCount, nullptr);
@@ -75,19 +76,32 @@ bool TextureCubeApp::isDeviceSuitable(VkPhysicalDevice device) {
 	// Check that this device has the correct queues that we will use
 	QueueFamilyIndices indices = findQueueFamilies(device);
 	// Check that this device supports all the extension we will need
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
+	// (headless needs none, so any device will do, even a software one)
+	bool extensionsSupported = mHeadless || checkDeviceExtensionSupport(device);
+	// The uploads are synchronized with timeline semaphores (Vulkan 1.2)
+	bool timelineSupported = false;
+	if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &vulkan12Features;
+		vkGetPhysicalDeviceFeatures2(device, &features2);
+		timelineSupported = vulkan12Features.timelineSemaphore;
+	}
 	// If the extension is supported the see if the swapchain is compatible with the surface
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	bool swapChainAdequate = mHeadless;
+	if (extensionsSupported && !mHeadless) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
 
-	return indices.isComplete() && extensionsSupported && 
+	return indices.isComplete() && extensionsSupported && timelineSupported &&
 		swapChainAdequate && supportedFeatures.samplerAnisotropy;
 }
 
 void TextureCubeApp::createLogicalDevice() {
+	TRACE_FUNCTION();
 	// In order to create the device we need two structures
 
 	// First, the queues structures
@@ -98,7 +112,8 @@ void TextureCubeApp::createLogicalDevice() {
 	// several indices are the same
 	std::set<uint32_t> uniqueQueueFamilies = {
 		indices.graphicsFamily.value(),
-		indices.presentFamily.value()
+		indices.presentFamily.value(),
+		indices.transferFamily.value()
 	};
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -116,6 +131,29 @@ void TextureCubeApp::createLogicalDevice() {
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.sampleRateShading = VK_TRUE; // enable sample shading feature for the device
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	// Plus the timeline semaphores for the uploads
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+	// The GPU culling writes its own draws, and needs the optional indirect features
+	VkPhysicalDeviceVulkan12Features supported12Features{};
+	supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supported12Features;
+	vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &supportedFeatures);
+	mGpuCullingSupported = supported12Features.drawIndirectCount &&
+		supportedFeatures.features.multiDrawIndirect &&
+		supportedFeatures.features.drawIndirectFirstInstance;
+	if (mGpuCullingSupported) {
+		vulkan12Features.drawIndirectCount = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
+	// The profilers reset their queries from the host, so a transfer only queue
+	// (that can not record the reset) can still be timed
+	mHostQueryResetSupported = supported12Features.hostQueryReset;
+	vulkan12Features.hostQueryReset = supported12Features.hostQueryReset;
 
 	// Now, that we have those two structs, we can create our logical device
 	VkDeviceCreateInfo createInfo{};
@@ -127,6 +165,7 @@ void TextureCubeApp::createLogicalDevice() {
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
+	createInfo.pNext = &vulkan12Features;
 
 	// This, is not strictlly needed in modern drivers,
 	// (they just ignore it)
@@ -139,17 +178,66 @@ void TextureCubeApp::createLogicalDevice() {
 		createInfo.enabledLayerCount = 0;
 	}
 	// Enable the required extensions on this device
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(mDeviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = mDeviceExtensions.data();
+	std::vector<const char*> extensions;
+	if (!mHeadless) {
+		extensions.assign(mDeviceExtensions.begin(), mDeviceExtensions.end());
+	}
+	// Plus the optional ones, only if they are available
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &deviceProperties);
+	mMemoryBudgetSupported = deviceProperties.apiVersion >= VK_API_VERSION_1_1 &&
+		isDeviceExtensionSupported(mPhysicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (mMemoryBudgetSupported) {
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	// The low latency mode waits for the presents, if the device can tell when they happen.
+	// The extensions are newer than the 1.2.176 / 1.2.170 SDKs of the project, built
+	// with those the mode times until the gpu is done instead
+#ifdef VK_KHR_present_wait
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.pNext = &presentWaitFeatures;
+	mPresentWaitSupported = mLowLatency &&
+		isDeviceExtensionSupported(mPhysicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+		isDeviceExtensionSupported(mPhysicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	if (mPresentWaitSupported) {
+		VkPhysicalDeviceFeatures2 presentFeatures{};
+		presentFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		presentFeatures.pNext = &presentIdFeatures;
+		vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &presentFeatures);
+		mPresentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+	}
+	if (mPresentWaitSupported) {
+		// The query left both features on, the same structs enable them
+		vulkan12Features.pNext = &presentIdFeatures;
+		extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
+#endif
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	// Finally, try to create the logical device
-	if (vkCreateDevice(mPhysicalDevice, &createInfo, nullptr, &mDevice) != VK_SUCCESS) {
+	if (vkCreateDevice(mPhysicalDevice, &createInfo, mHostCallbacks, &mDevice) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create logical device!");
 	}
 
 	// We can adquire the queues handles too, since we just adquiere the device
 	vkGetDeviceQueue(mDevice, indices.graphicsFamily.value(), 0, &mGraphicsQueue);
 	vkGetDeviceQueue(mDevice, indices.presentFamily.value(), 0, &mPresentQueue);
+	vkGetDeviceQueue(mDevice, indices.transferFamily.value(), 0, &mTransferQueue);
+
+#ifdef VK_KHR_present_wait
+	if (mPresentWaitSupported) {
+		mWaitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(mDevice, "vkWaitForPresentKHR");
+	}
+#endif
+	if (mLowLatency) {
+		std::cout << "[latency] " << (mPresentWaitSupported ? "waiting for the presents" :
+			"no present wait, timing until the gpu is done") << std::endl;
+	}
 }
 
 bool TextureCubeApp::checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -169,6 +257,20 @@ bool TextureCubeApp::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	return requiredExtensions.empty();
 }
 
+bool TextureCubeApp::isDeviceExtensionSupported(VkPhysicalDevice device,
+	const char* extensionName) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+	for (const auto& extension : availableExtensions) {
+		if (std::string(extension.extensionName) == extensionName) {
+			return true;
+		}
+	}
+	return false;
+}
+
 QueueFamilyIndices TextureCubeApp::findQueueFamilies(VkPhysicalDevice device) {
 	QueueFamilyIndices indices;
 
@@ -180,23 +282,36 @@ QueueFamilyIndices TextureCubeApp::findQueueFamilies(VkPhysicalDevice device) {
 
 	int i = 0;
 	for (const auto& queueFamily : queueFamilies) {
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && !indices.graphicsFamily.has_value()) {
 			indices.graphicsFamily = i;
 		}
-		// Check if this queue can render to our surface
+		// Check if this queue can render to our surface (headless presents nothing,
+		// the graphics queue stands in)
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
-		if (presentSupport) {
+		if (mHeadless) {
+			presentSupport = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT ? VK_TRUE : VK_FALSE;
+		} else {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+		}
+		if (presentSupport && !indices.presentFamily.has_value()) {
 			indices.presentFamily = i;
 		}
-
-		// If we already have all our queues we can early exit
-		if (indices.isComplete()) {
-			break;
+		// A transfer family without graphics is usually a dedicated DMA engine,
+		// the best ones do not even do compute
+		if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+			!(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+			bool dedicated = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+			if (!indices.transferFamily.has_value() || dedicated) {
+				indices.transferFamily = i;
+			}
 		}
 
 		i++;
 	}
+	// No dedicated one, the graphics queue can always do the copies
+	if (!indices.transferFamily.has_value()) {
+		indices.transferFamily = indices.graphicsFamily;
+	}
 
 	return indices;
 }
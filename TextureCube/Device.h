@@ -11,6 +11,8 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	// A family just for copies if the device has one, the graphics one otherwise
+	std::optional<uint32_t> transferFamily;
 	inline bool isComplete() const {
 		return graphicsFamily.has_value() && presentFamily.has_value();
 	}
@@ -22,3 +24,9 @@ struct SwapChainSupportDetails {
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
+
+// What the swapchain recreations had to rebuild, a resize should only touch the swapchain
+struct SwapChainStats {
+	uint32_t recreations{ 0 };
+	uint32_t pipelineRebuilds{ 0 };
+};
@@ -1,15 +1,22 @@
+#include <algorithm>
+#include <future>
+#include <iomanip>
+#include <vector>
+
 #include "Vertex.h"
 #include "TextureCubeApp.h"
 
 void TextureCubeApp::createFramebuffers() {
+	TRACE_FUNCTION();
 	// Make sure container can hold all the required FB (one per image in the swapchain)
 	mSwapChainFramebuffers.resize(mSwapChainImageViews.size());
 
 	for (size_t i = 0; i < mSwapChainImageViews.size(); i++) {
+		// The dynamic resolution resolves to the scene image, the upscale fills the swapchain one
 		std::array<VkImageView, 3> attachments = {
 			mColorImageView,
 			mDepthImageView,
-			mSwapChainImageViews[i]
+			mDynamicResolution ? mSceneImageView : mSwapChainImageViews[i]
 		};
 
 		VkFramebufferCreateInfo framebufferInfo{};
@@ -21,13 +28,14 @@ void TextureCubeApp::createFramebuffers() {
 		framebufferInfo.height = mSwapChainExtent.height;
 		framebufferInfo.layers = 1;
 
-		if (vkCreateFramebuffer(mDevice, &framebufferInfo, nullptr, &mSwapChainFramebuffers[i]) != VK_SUCCESS) {
+		if (vkCreateFramebuffer(mDevice, &framebufferInfo, mHostCallbacks, &mSwapChainFramebuffers[i]) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create framebuffer!");
 		}
 	}
 }
 
 void TextureCubeApp::createCommandPool() {
+	TRACE_FUNCTION();
 	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(mPhysicalDevice);
 
 	VkCommandPoolCreateInfo poolInfo{};
@@ -35,111 +43,468 @@ void TextureCubeApp::createCommandPool() {
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 	poolInfo.flags = 0; // Optional
 
-	if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mCommandPool) != VK_SUCCESS) {
+	if (vkCreateCommandPool(mDevice, &poolInfo, mHostCallbacks, &mCommandPool) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create command pool!");
 	}
 
 }
 
-void TextureCubeApp::createCommandBuffers() {
-	// We need to create one command buffer per each image in the swapchain
-	mCommandBuffers.resize(mSwapChainFramebuffers.size());
-	// We allocate memmory for the command buffers
+void TextureCubeApp::createRecordingCommands(VkCommandBufferLevel level,
+	RecordingCommands& commands) {
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = mGraphicsFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	if (vkCreateCommandPool(mDevice, &poolInfo, mHostCallbacks, &commands.commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create frame command pool!");
+	}
+
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = mCommandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = (uint32_t)mCommandBuffers.size();
+	allocInfo.commandPool = commands.commandPool;
+	allocInfo.level = level;
+	allocInfo.commandBufferCount = 1;
 
-	if (vkAllocateCommandBuffers(mDevice, &allocInfo, mCommandBuffers.data()) != VK_SUCCESS) {
+	if (vkAllocateCommandBuffers(mDevice, &allocInfo, &commands.commandBuffer) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate command buffers!");
 	}
+}
 
-	for (size_t i = 0; i < mCommandBuffers.size(); i++) {
-		// We need to make the beggining of the coomand buffer
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT; // Not Optional anymore !
-		beginInfo.pInheritanceInfo = nullptr; // Optional
+VkSemaphore TextureCubeApp::createTimelineSemaphore() {
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
 
-		if (vkBeginCommandBuffer(mCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
 
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = mRenderPass;
-		renderPassInfo.framebuffer = mSwapChainFramebuffers[i];
-
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = mSwapChainExtent;
-
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.15f, 0.15f, 0.15f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-
-		/* Recording the commands */
-		vkCmdBeginRenderPass(mCommandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		// Bind the desired pipeline 
-		vkCmdBindPipeline(mCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
-		// Send all the vertex buffers, (we are just using one)
-		VkBuffer vertexBuffers[] = { mVertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(mCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-		// Send the index buffer (only one possible)
-		vkCmdBindIndexBuffer(mCommandBuffers[i], mIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		// Send the corresponding descriptors (that contain the uniforms)
-		vkCmdBindDescriptorSets(mCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, 
-			mPipelineLayout, 0, 1, &mDescriptorSets[i], 0, nullptr);
-		// Actual render command
-		vkCmdDrawIndexed(mCommandBuffers[i], static_cast<uint32_t>(mIndices.size()), 1, 0, 0, 0);
-		// End the render pass
-		vkCmdEndRenderPass(mCommandBuffers[i]);
-
-		if (vkEndCommandBuffer(mCommandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+	VkSemaphore semaphore;
+	if (vkCreateSemaphore(mDevice, &semaphoreInfo, mHostCallbacks, &semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timeline semaphore!");
 	}
+	return semaphore;
 }
 
-void TextureCubeApp::createSyncObjects() {
+void TextureCubeApp::createFrameTimeline() {
+	TRACE_FUNCTION();
+	// Before the uploads, their graphics side signals it too
+	mFrameTimeline = createTimelineSemaphore();
+	mFrameTimelineValue = 0;
+	mLastUploadValue = 0;
+}
+
+void TextureCubeApp::waitFrameTimeline(uint64_t value) {
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &mFrameTimeline;
+	waitInfo.pValues = &value;
+	if (vkWaitSemaphores(mDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("failed to wait for the frame timeline!");
+	}
+}
 
-	mImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	mRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	mInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-	mImagesInFlight.resize(mSwapChainImages.size(), VK_NULL_HANDLE);
-	// For the semaphores
+void TextureCubeApp::createFrameContexts() {
+	TRACE_FUNCTION();
+	// One set of pools per frame in flight, so a frame can throw away all its
+	// commands at once while the other frames are still on the GPU
+	mFrames.resize(mOptions.framesInFlight);
+	// The frames start at value 0, the first wait of every frame has nothing to wait for
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	//For the fences
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		if (vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mImageAvailableSemaphores[i])
-			!= VK_SUCCESS ||
-			vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mRenderFinishedSemaphores[i])
+	for (auto& frame : mFrames) {
+		createRecordingCommands(VK_COMMAND_BUFFER_LEVEL_PRIMARY, frame.primary);
+		frame.workers.resize(mRecordThreads);
+		for (auto& worker : frame.workers) {
+			createRecordingCommands(VK_COMMAND_BUFFER_LEVEL_SECONDARY, worker);
+		}
+		if (vkCreateSemaphore(mDevice, &semaphoreInfo, mHostCallbacks, &frame.imageAvailable)
 			!= VK_SUCCESS ||
-			vkCreateFence(mDevice, &fenceInfo, nullptr, &mInFlightFences[i])
+			vkCreateSemaphore(mDevice, &semaphoreInfo, mHostCallbacks, &frame.renderFinished)
 			!= VK_SUCCESS) {
 
 			throw std::runtime_error("failed to create sync objects for a frame!");
 		}
 	}
 
+	for (size_t i = 0; i < mFrames.size(); i++) {
+		mFrames[i].slot = static_cast<uint32_t>(i);
+	}
+	mFrameProfiler = std::make_unique<GpuProfiler>(mDevice, mPhysicalDevice, mGraphicsFamily,
+		static_cast<uint32_t>(mFrames.size()), MAX_GPU_SCOPES, mHostQueryResetSupported,
+		mHostCallbacks);
+	if (mDynamicResolution && !mFrameProfiler->enabled()) {
+		std::cerr << "[resolution] no gpu timestamps on the graphics queue, the scale stays at "
+			<< static_cast<int>(mRenderScale * 100.0f) << "%" << std::endl;
+	}
+}
+
+void TextureCubeApp::destroyFrameContexts() {
+	for (auto& frame : mFrames) {
+		// Destroying the pools frees their command buffers too
+		vkDestroyCommandPool(mDevice, frame.primary.commandPool, mHostCallbacks);
+		for (auto& worker : frame.workers) {
+			vkDestroyCommandPool(mDevice, worker.commandPool, mHostCallbacks);
+		}
+		vkDestroySemaphore(mDevice, frame.renderFinished, mHostCallbacks);
+		vkDestroySemaphore(mDevice, frame.imageAvailable, mHostCallbacks);
+	}
+	mFrames.clear();
+	mFrameProfiler.reset();
+}
+
+void TextureCubeApp::retireFrames() {
+	// One read of the counter tells which frames are done, and about when
+	uint64_t completedValue;
+	vkGetSemaphoreCounterValue(mDevice, mFrameTimeline, &completedValue);
+	auto now = std::chrono::steady_clock::now();
+	for (auto& frame : mFrames) {
+		if (frame.pending && frame.timelineValue <= completedValue) {
+			frame.latencyMs = std::chrono::duration<double, std::milli>(now - frame.cpuStart).count();
+			frame.latencyFrame = frame.timestampFrame;
+			frame.pending = false;
+		}
+	}
+}
+
+void TextureCubeApp::resetFrameCommands(FrameContext& frame) {
+	vkResetCommandPool(mDevice, frame.primary.commandPool, 0);
+	for (auto& worker : frame.workers) {
+		vkResetCommandPool(mDevice, worker.commandPool, 0);
+	}
+}
+
+void TextureCubeApp::collectFrameTimes(FrameContext& frame) {
+	frame.gpuTimeMs = -1.0;
+	// Only called once the timeline reached the frame's value, so the results are there
+	if (!mFrameProfiler->collect(frame.slot, frame.gpuScopes)) {
+		return;
+	}
+	frame.gpuTimeFrame = frame.timestampFrame;
+	for (const auto& scope : frame.gpuScopes) {
+		if (scope.name == "frame") {
+			frame.gpuTimeMs = scope.ms;
+		}
+	}
+}
+
+void TextureCubeApp::logGpuTimes() {
+	std::cout << std::fixed << std::setprecision(3) << "[gpu]";
+	for (const GpuProfiler* profiler : { mFrameProfiler.get(), mTransferProfiler.get(),
+		mUploadProfiler.get() }) {
+		if (profiler == nullptr) {
+			continue;
+		}
+		for (const auto& scope : profiler->totals()) {
+			const GpuScopeStats& stats = scope.second;
+			std::cout << " " << scope.first << " " << stats.totalMs / stats.count << " ms (max "
+				<< stats.maxMs << ", " << stats.count << "x)";
+		}
+	}
+	std::cout << std::defaultfloat << std::endl;
+	// The frames since the previous line, the uploads since the start
+	mFrameProfiler->resetTotals();
+}
+
+void TextureCubeApp::recordCommandBuffer(FrameContext& frame, uint32_t imageIndex,
+	uint32_t instanceCount, uint32_t threadCount, DrawMode mode) {
+	TRACE_FUNCTION();
+
+	// Pick up the pipelines that finished compiling since the last frame
+	resolvePipelines();
+	VkCommandBuffer commandBuffer = frame.primary.commandBuffer;
+	// We need to make the beggining of the coomand buffer
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	// It is recorded again every frame, and submitted only once
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = nullptr; // Optional
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
+	// The queries are reset here, outside of the render pass
+	mFrameProfiler->beginSlot(commandBuffer, frame.slot);
+	uint32_t frameScope = mFrameProfiler->beginScope(commandBuffer, frame.slot, "frame");
+
+	if (mode == DrawMode::GpuCulled) {
+		// Compute work can not happen inside the render pass
+		uint32_t cullingScope = mFrameProfiler->beginScope(commandBuffer, frame.slot, "culling");
+		recordCulling(frame, instanceCount);
+		mFrameProfiler->endScope(commandBuffer, frame.slot, cullingScope);
+	}
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = mRenderPass;
+	renderPassInfo.framebuffer = mSwapChainFramebuffers[imageIndex];
+
+	// The dynamic resolution only renders the top left part, as big as the scale
+	frame.renderScale = mDynamicResolution ? mRenderScale : 1.0f;
+	frame.renderExtent = scaledExtent(frame.renderScale);
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = frame.renderExtent;
+
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { 0.15f, 0.15f, 0.15f, 1.0f };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfo.pClearValues = clearValues.data();
+
+	// The draws themselves live in the secondary buffers
+	uint32_t renderPassScope = mFrameProfiler->beginScope(commandBuffer, frame.slot, "render pass");
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+		VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	bool drawPerInstance = mode == DrawMode::PerInstance || mode == DrawMode::CpuCulled;
+	if (mode == DrawMode::CpuCulled) {
+		// The draws go only to the instances inside the frustum
+		mCuller.cull(mFrustum, mVisibleInstances, mThreadPool.get());
+		instanceCount = static_cast<uint32_t>(mVisibleInstances.size());
+	}
+	if (drawPerInstance) {
+		// Sorted by state, so the recording threads find as many binds already done as possible
+		buildRenderQueue(mode == DrawMode::CpuCulled ? &mVisibleInstances : nullptr, instanceCount);
+	}
+	// A single (instanced or indirect) draw has nothing to split. Otherwise every instance
+	// is its own draw: split them in contiguous ranges, but do not wake a thread for a few
+	uint32_t drawCount = drawPerInstance ? instanceCount : 1;
+	threadCount = std::min(threadCount, static_cast<uint32_t>(frame.workers.size()));
+	uint32_t neededThreads = (drawCount + MIN_DRAWS_PER_THREAD - 1) / MIN_DRAWS_PER_THREAD;
+	threadCount = std::max(std::min(threadCount, neededThreads), 1u);
+	uint32_t drawsPerThread = (drawCount + threadCount - 1) / threadCount;
+
+	// Every secondary starts with nothing bound, each thread keeps its own state
+	std::vector<BoundState> states(threadCount);
+	auto recordRange = [this, &frame, &states, imageIndex, instanceCount, drawCount,
+		drawsPerThread, drawPerInstance, mode](uint32_t thread) {
+		if (!drawPerInstance) {
+			recordDrawRange(frame, thread, imageIndex, 0, instanceCount, mode, states[thread]);
+			return;
+		}
+		uint32_t firstDraw = std::min(thread * drawsPerThread, drawCount);
+		uint32_t lastDraw = std::min(firstDraw + drawsPerThread, drawCount);
+		recordDrawRange(frame, thread, imageIndex, firstDraw, lastDraw, mode, states[thread]);
+	};
+	// This thread records the first range while the pool takes care of the rest
+	std::vector<std::future<void>> pending;
+	for (uint32_t thread = 1; thread < threadCount; thread++) {
+		pending.push_back(mThreadPool->submit([recordRange, thread]() { recordRange(thread); }));
+	}
+	recordRange(0);
+	for (auto& recording : pending) {
+		// Rethrows whatever went wrong on the worker
+		recording.get();
+	}
+
+	// Keep the numbers of this frame around for the log
+	mBindStats = BindStats{};
+	mBindStats.draws = drawCount;
+	for (const auto& state : states) {
+		mBindStats.binds += state.binds;
+		mBindStats.elided += state.elided;
+	}
+
+	// Executed in order, so the result is the same as recording on one thread
+	std::vector<VkCommandBuffer> secondaries(threadCount);
+	for (uint32_t thread = 0; thread < threadCount; thread++) {
+		secondaries[thread] = frame.workers[thread].commandBuffer;
+	}
+	vkCmdExecuteCommands(commandBuffer, threadCount, secondaries.data());
+	// End the render pass
+	vkCmdEndRenderPass(commandBuffer);
+	mFrameProfiler->endScope(commandBuffer, frame.slot, renderPassScope);
+	if (mDynamicResolution) {
+		uint32_t upscaleScope = mFrameProfiler->beginScope(commandBuffer, frame.slot, "upscale");
+		recordUpscale(commandBuffer, imageIndex, frame.renderExtent);
+		mFrameProfiler->endScope(commandBuffer, frame.slot, upscaleScope);
+	}
+	mFrameProfiler->endScope(commandBuffer, frame.slot, frameScope);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+}
+
+void TextureCubeApp::buildRenderQueue(const std::vector<uint32_t>* instances, uint32_t count) {
+	mRenderQueue.clear();
+	mRenderQueue.reserve(count);
+	// Distances to the near and far planes give the depth without another matrix
+	const glm::vec4& nearPlane = mFrustum.planes[4];
+	const glm::vec4& farPlane = mFrustum.planes[5];
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t instance = instances != nullptr ? (*instances)[i] : i;
+		glm::vec3 center = glm::vec3(mInstanceBounds[instance]);
+		float toNear = glm::dot(glm::vec3(nearPlane), center) + nearPlane.w;
+		float toFar = glm::dot(glm::vec3(farPlane), center) + farPlane.w;
+		float depth = toNear / std::max(toNear + toFar, 1e-6f);
+		// There is a single mesh for now, every material has its own pipeline
+		uint32_t material = mInstances[instance].materialId;
+		uint64_t key = RenderQueue::makeKey(mMaterialPipelines[material], material,
+			mSceneMesh, depth);
+		mRenderQueue.push(key, instance);
+	}
+	mRenderQueue.sort();
+}
+
+void TextureCubeApp::bindDrawState(VkCommandBuffer commandBuffer, BoundState& state,
+	uint64_t key, VkDescriptorSet descriptorSet) {
+
+	// Ids in the key to the Vulkan objects. The pipeline may still be the fallback
+	// if its own is compiling, the material tint comes from the instance data, so
+	// all materials share a set (the frame's). Every mesh lives in the geometry pool,
+	// so the buffers never change either, the mesh only picks the ranges the draw reads
+	VkPipeline pipeline = mPipelineTable[RenderQueue::pipelineOf(key)];
+	VkBuffer vertexBuffer = mGeometryVertexBuffer;
+	VkBuffer indexBuffer = mGeometryIndexBuffer;
+
+	if (state.pipeline != pipeline) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		state.pipeline = pipeline;
+		state.binds++;
+	} else {
+		state.elided++;
+	}
+	if (state.vertexBuffer != vertexBuffer) {
+		// Send all the vertex buffers, the mesh and the per instance data
+		VkBuffer vertexBuffers[] = { vertexBuffer, mInstanceBuffer };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+		state.vertexBuffer = vertexBuffer;
+		state.binds++;
+	} else {
+		state.elided++;
+	}
+	if (state.indexBuffer != indexBuffer) {
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		state.indexBuffer = indexBuffer;
+		state.binds++;
+	} else {
+		state.elided++;
+	}
+	if (state.descriptorSet != descriptorSet) {
+		// Send the corresponding descriptors (that contain the uniforms)
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			mPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		state.descriptorSet = descriptorSet;
+		state.binds++;
+	} else {
+		state.elided++;
+	}
+}
+
+void TextureCubeApp::recordDrawRange(FrameContext& frame, uint32_t worker, uint32_t imageIndex,
+	uint32_t firstInstance, uint32_t lastInstance, DrawMode mode, BoundState& state) {
+	TRACE_FUNCTION();
+
+	VkCommandBuffer commandBuffer = frame.workers[worker].commandBuffer;
+	// Secondaries run inside the render pass the primary began
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = mRenderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = mSwapChainFramebuffers[imageIndex];
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+		VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording secondary command buffer!");
+	}
+
+	/* Recording the commands, no state is inherited from the primary */
+	// The viewport follows the render area, the pipeline leaves it dynamic
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)frame.renderExtent.width;
+	viewport.height = (float)frame.renderExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = frame.renderExtent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	// Actual render commands, either one draw for all the instances, the draws the
+	// culling wrote for the visible ones, or one per instance in the sorted queue
+	// (the first instance picks its data from the instance buffer)
+	if (mode == DrawMode::Instanced) {
+		const MeshRange& mesh = mMeshes[mSceneMesh];
+		bindDrawState(commandBuffer, state,
+			RenderQueue::makeKey(mScenePipeline, 0, mSceneMesh, 0.0f), frame.descriptorSet);
+		vkCmdDrawIndexed(commandBuffer, mesh.indexCount, lastInstance - firstInstance,
+			mesh.firstIndex, static_cast<int32_t>(mesh.firstVertex), firstInstance);
+	} else if (mode == DrawMode::GpuCulled) {
+		bindDrawState(commandBuffer, state,
+			RenderQueue::makeKey(mScenePipeline, 0, mSceneMesh, 0.0f), frame.descriptorSet);
+		vkCmdDrawIndexedIndirectCount(commandBuffer, frame.drawCommandBuffer, 0,
+			frame.drawCountBuffer, 0, lastInstance - firstInstance,
+			sizeof(VkDrawIndexedIndirectCommand));
+	} else {
+		const std::vector<DrawItem>& items = mRenderQueue.items();
+		for (uint32_t i = firstInstance; i < lastInstance; i++) {
+			const MeshRange& mesh = mMeshes[RenderQueue::meshOf(items[i].key)];
+			bindDrawState(commandBuffer, state, items[i].key, frame.descriptorSet);
+			vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.firstIndex,
+				static_cast<int32_t>(mesh.firstVertex), items[i].instance);
+		}
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record secondary command buffer!");
+	}
 }
 
 void TextureCubeApp::drawFrame() {
-	vkWaitForFences(mDevice, 1, &mInFlightFences[mCurrentFrame], VK_TRUE, UINT64_MAX);
+	TRACE_FUNCTION();
+	FrameContext& frame = mFrames[mCurrentFrame];
+	if (mLowLatency) {
+		// Before the waits and the bookkeeping below, the queued frame may be on
+		// the screen already
+		pollQueuedFrame();
+	}
+	{
+		TRACE_SCOPE("wait for frame");
+		// Exactly the value of this frame's last submit, whatever came after it
+		// (the other frames, the uploads) can still be running
+		waitFrameTimeline(frame.timelineValue);
+	}
+	// This frame and maybe others are done, and so are their timestamps
+	retireFrames();
+	collectFrameTimes(frame);
+	if (mDynamicResolution) {
+		updateRenderScale(frame);
+		reportRenderScale(frame);
+	}
+	frame.cpuStart = std::chrono::steady_clock::now();
+	// Staging buffers of the uploads that are already done can go away
+	releaseFinishedUploads();
+	if (mLowLatency) {
+		// Nothing is queued for the display while we record, so the input
+		// we sample next is shown as soon as possible
+		waitForQueuedFrame();
+	}
 
 	uint32_t imageIndex;
-	// Query for the index of the next available image in the swapchain
-	// We also pass down async object to signal
-	VkResult result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX,
-		mImageAvailableSemaphores[mCurrentFrame], VK_NULL_HANDLE, &imageIndex);
+	VkResult result = VK_SUCCESS;
+	if (mHeadless) {
+		// Offscreen images are ours, no need to ask (nor to wait) for them
+		imageIndex = acquireOffscreenImage();
+	} else {
+		// Query for the index of the next available image in the swapchain
+		// We also pass down async object to signal
+		TRACE_SCOPE("acquire image");
+		result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX,
+			frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+	}
 	// Check that the swapchain still matches this surface
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapChain();
@@ -148,44 +513,78 @@ void TextureCubeApp::drawFrame() {
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		throw std::runtime_error("failed to acquire swap chain image!");
 	}
-	// Check if a previous frame is using this image (i.e. there is its fence to wait on)
-	if (mImagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-		vkWaitForFences(mDevice, 1, &mImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+	if (mLowLatency) {
+		// As late as possible, acquiring may have blocked for a while
+		sampleInput();
 	}
-	// Mark the image as now being in use by this frame
-	mImagesInFlight[imageIndex] = mInFlightFences[mCurrentFrame];
-	updateUniformBuffer(imageIndex);
+	// Whatever the image, everything the frame writes is its own. The image
+	// itself is only handed to us once its previous present is done with it
+	updateUniformBuffer(frame);
+	// The timeline told us the GPU is done with this frame's previous commands,
+	// so we can recycle them and record the current state of the scene
+	resetFrameCommands(frame);
+	recordCommandBuffer(frame, imageIndex, static_cast<uint32_t>(mInstances.size()),
+		mRecordThreads, mDrawMode);
 	// Prepare to submit commend to the queue
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	// Set of conditions (we olnly heve one) to wait before executing
-	VkSemaphore waitSemaphores[] = { mImageAvailableSemaphores[mCurrentFrame] };
-	// At which stage to wait
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	// Set of conditions to wait before executing: the image and the uploads
+	VkSemaphore waitSemaphores[] = { frame.imageAvailable, mFrameTimeline };
+	// At which stage to wait. The uploads are read by the draws, and by the culling
+	// (bounds and instances) and the indirect draws it feeds. With a single queue
+	// family there is no acquire barrier, this wait is the only thing ordering them
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
+	// The binary semaphore ignores its value, the timeline one waits for the last upload
+	uint64_t waitValues[] = { 0, mLastUploadValue };
+	// The frame takes the next value of the timeline, the same it waits on
+	frame.timelineValue = ++mFrameTimelineValue;
+	VkSemaphore signalSemaphores[] = { mFrameTimeline, frame.renderFinished };
+	uint64_t signalValues[] = { frame.timelineValue, 0 };
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	// Offscreen there is no acquired image to wait for, only the uploads
+	uint32_t firstWait = mHeadless ? 1 : 0;
+	timelineInfo.waitSemaphoreValueCount = 2 - firstWait;
+	timelineInfo.pWaitSemaphoreValues = waitValues + firstWait;
+	// (nobody presents offscreen, so nobody would wait on the binary one)
+	uint32_t signalCount = mHeadless ? 1 : 2;
+	timelineInfo.signalSemaphoreValueCount = signalCount;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = 2 - firstWait;
 	// Indcies makes a correspondence between the two arrays
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-	// select the buffer to submit (using the image index)
+	submitInfo.pWaitSemaphores = waitSemaphores + firstWait;
+	submitInfo.pWaitDstStageMask = waitStages + firstWait;
+	// select the buffer to submit (the one we just recorded)
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &mCommandBuffers[imageIndex];
-	// Set of conditions (again, only one) to signal once we finish
-	VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[mCurrentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pCommandBuffers = &frame.primary.commandBuffer;
+	// Set of conditions to signal once we finish, no fence: the CPU waits on the timeline
+	submitInfo.signalSemaphoreCount = signalCount;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
-	vkResetFences(mDevice, 1, &mInFlightFences[mCurrentFrame]);
-
 	// Submit to the queue
-	if (vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, mInFlightFences[mCurrentFrame]) != VK_SUCCESS) {
-		throw std::runtime_error("failed to submit draw command buffer!");
+	{
+		TRACE_SCOPE("submit");
+		if (vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+	}
+	mFrameProfiler->submitSlot(frame.slot);
+	frame.timestampFrame = mFrameNumber++;
+	frame.pending = true;
+	if (mHeadless) {
+		// The frame stays in the offscreen image
+		mCurrentFrame = (mCurrentFrame + 1) % mFrames.size();
+		return;
 	}
 	// Prepare to present the frame
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	presentInfo.pWaitSemaphores = &frame.renderFinished;
 
 	VkSwapchainKHR swapChains[] = { mSwapChain };
 	presentInfo.swapchainCount = 1;
@@ -193,8 +592,33 @@ void TextureCubeApp::drawFrame() {
 	presentInfo.pImageIndices = &imageIndex;
 
 	presentInfo.pResults = nullptr; // Optional
+	// Low latency mode tags the present, so the next frame can wait for it
+	uint64_t presentId = 0;
+#ifdef VK_KHR_present_wait
+	VkPresentIdKHR presentIdInfo{};
+	presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentIdInfo.swapchainCount = 1;
+	presentIdInfo.pPresentIds = &presentId;
+	if (mPresentWaitSupported) {
+		presentId = ++mPresentId;
+		presentInfo.pNext = &presentIdInfo;
+	}
+#endif
 	// Present the frame
-	result = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+	{
+		TRACE_SCOPE("present");
+		result = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+	}
+	if (mLowLatency) {
+		mPendingPresent.pending = true;
+		mPendingPresent.presentId = presentId;
+		mPendingPresent.timelineValue = frame.timelineValue;
+		mPendingPresent.frameNumber = frame.timestampFrame;
+		mPendingPresent.inputTime = mInputTime;
+		mPendingPresent.completed = false;
+		// Already on the screen with an immediate present mode
+		pollQueuedFrame();
+	}
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || mFramebufferResized) {
 		mFramebufferResized = false;
 		recreateSwapChain();
@@ -203,5 +627,5 @@ void TextureCubeApp::drawFrame() {
 		throw std::runtime_error("failed to present swap chain image!");
 	}
 
-	mCurrentFrame = (mCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	mCurrentFrame = (mCurrentFrame + 1) % mFrames.size();
 }
\ No newline at end of file
@@ -6,14 +6,16 @@
 #include "TextureCubeApp.h"
 
 std::vector<const char*> TextureCubeApp::getRequiredExtensions() {
+	std::vector<const char*> extensions;
 	// Query which extensions requiere this windows manager
-	// The answer is platform specific!!
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-	std::vector<const char*> extensions(/* begin = */glfwExtensions,
-		/* end = */glfwExtensions + glfwExtensionCount);
+	// The answer is platform specific!! (and there is none without a window)
+	if (!mHeadless) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.assign(/* begin = */glfwExtensions,
+			/* end = */glfwExtensions + glfwExtensionCount);
+	}
 
 	// If we want validation layer we add it to the requied list
 	if (mEnableValidationLayers) {
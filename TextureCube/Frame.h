@@ -0,0 +1,140 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Culling.h"
+#include "GpuProfiler.h"
+
+// How the instances of the scene reach the GPU
+enum class DrawMode {
+	// A single draw for all of them
+	Instanced,
+	// One draw per instance, split across the recording threads
+	PerInstance,
+	// Like PerInstance, but only for the instances the CPU culling left visible
+	CpuCulled,
+	// A compute pass culls them and writes the draws of the visible ones
+	GpuCulled
+};
+
+// Specialization constants of simple.frag, in the order of their constant_id
+struct ShadingConstants {
+	// Material the pipeline is built for, -1 to look it up per fragment
+	int32_t material{ -1 };
+	VkBool32 diffuseTexture{ VK_TRUE };
+	VkBool32 specularTexture{ VK_TRUE };
+	float shininess{ 4.0f };
+	// Direction of the light, in view space
+	float lightX{ 0.0f };
+	float lightY{ 0.75f };
+	float lightZ{ 1.0f };
+};
+
+// What changes between the graphics pipelines the draws can use
+struct PipelineVariant {
+	std::string name;
+	// Run the fragment shader per sample (smoother, but more expensive)
+	bool sampleShading;
+	ShadingConstants shading;
+};
+
+// A command pool with the one buffer we record from it. Pools can only be
+// used by one thread at a time, so every recording thread gets its own
+struct RecordingCommands {
+	VkCommandPool commandPool{ VK_NULL_HANDLE };
+	VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+};
+
+// What a command buffer has bound, so the same bind is not recorded twice
+struct BoundState {
+	VkPipeline pipeline{ VK_NULL_HANDLE };
+	VkBuffer vertexBuffer{ VK_NULL_HANDLE };
+	VkBuffer indexBuffer{ VK_NULL_HANDLE };
+	VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+	// Binds recorded and binds skipped because they were already current
+	uint32_t binds{ 0 };
+	uint32_t elided{ 0 };
+};
+
+// Totals of the last recorded frame
+struct BindStats {
+	uint32_t draws{ 0 };
+	uint32_t binds{ 0 };
+	uint32_t elided{ 0 };
+};
+
+// The last frame presented in low latency mode, the next frame waits for it
+struct PendingPresent {
+	bool pending{ false };
+	// Id given to its present (VK_KHR_present_id), 0 without present wait
+	uint64_t presentId{ 0 };
+	// Value of the frame timeline its commands signal
+	uint64_t timelineValue{ 0 };
+	uint64_t frameNumber{ 0 };
+	// When the input it shows was sampled
+	std::chrono::steady_clock::time_point inputTime{};
+	// When a poll or the wait first saw it on the screen (or the GPU done)
+	bool completed{ false };
+	std::chrono::steady_clock::time_point completionTime{};
+};
+
+// Everything a frame in flight owns. Nothing in it is tied to a swapchain
+// image, so there are as many as frames in flight, whatever the image count.
+// Once the frame timeline reaches the frame's value all of it can be reused:
+// the pools are reset as a whole, the commands recorded again and the
+// uniforms rewritten
+struct FrameContext {
+	// Primary buffer, begins the render pass and executes the secondaries
+	RecordingCommands primary;
+	// One secondary buffer per recording thread, each with a range of draws
+	std::vector<RecordingCommands> workers;
+	// Slice of the uniform buffer the frame writes, mapped for as long as it lives
+	VkDeviceSize uniformOffset{ 0 };
+	void* uniformData{ nullptr };
+	// Points to the frame's uniform slice and to the textures
+	VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+	// Signaled once the image is acquired, and once the frame is rendered (for the
+	// present). The swapchain only takes binary semaphores
+	VkSemaphore imageAvailable{ VK_NULL_HANDLE };
+	VkSemaphore renderFinished{ VK_NULL_HANDLE };
+	// Value of the frame timeline its last submit signals, the GPU is done with
+	// everything above once the timeline reaches it
+	uint64_t timelineValue{ 0 };
+	// GPU culling output: the draws of the visible objects and how many they are
+	VkBuffer drawCommandBuffer{ VK_NULL_HANDLE };
+	VkDeviceMemory drawCommandMemory{ VK_NULL_HANDLE };
+	VkBuffer drawCountBuffer{ VK_NULL_HANDLE };
+	VkDeviceMemory drawCountMemory{ VK_NULL_HANDLE };
+	VkDescriptorSet cullingSet{ VK_NULL_HANDLE };
+	// Copy of the count the CPU can read once the frame is done
+	VkBuffer visibleCountBuffer{ VK_NULL_HANDLE };
+	VkDeviceMemory visibleCountMemory{ VK_NULL_HANDLE };
+	uint32_t* visibleCount{ nullptr };
+	// Frustum the objects were culled against
+	Frustum frustum{};
+	// Scale of the dynamic resolution the frame was recorded with, and the part
+	// of the image it rendered to (the whole swapchain extent without it)
+	float renderScale{ 1.0f };
+	VkExtent2D renderExtent{};
+	// Position in the ring of frames, also the slot of the frame in the GPU profiler
+	uint32_t slot{ 0 };
+	// Frame whose commands are being timed
+	uint64_t timestampFrame{ 0 };
+	// Last GPU times read back and the frame they belong to. The whole frame
+	// is also kept apart (negative if unknown)
+	std::vector<GpuScopeTime> gpuScopes;
+	double gpuTimeMs{ -1.0 };
+	uint64_t gpuTimeFrame{ 0 };
+	// When the CPU started the frame, and how long until it saw the timeline
+	// reach its value. More frames in flight trade this latency for throughput
+	std::chrono::steady_clock::time_point cpuStart{};
+	bool pending{ false };
+	double latencyMs{ -1.0 };
+	uint64_t latencyFrame{ 0 };
+};
@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstring>
+#include <future>
+
+#include "FrustumCuller.h"
+#include "ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CULLER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC lets us use any intrinsic, the CPU check at runtime keeps it safe
+#define CULLER_TARGET_AVX2
+#else
+// GCC and Clang need to be told the function may use AVX2
+#define CULLER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+#ifdef CULLER_X86
+bool cpuHasAvx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	// AVX needs the OS to save the YMM registers too (OSXSAVE and XCR0)
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// For every mask of 8 visible bits, the lanes of the visible objects packed at the start
+struct CompactTable {
+	alignas(32) std::array<std::array<uint32_t, 8>, 256> lanes;
+	std::array<uint32_t, 256> counts;
+
+	CompactTable() {
+		for (uint32_t mask = 0; mask < 256; mask++) {
+			uint32_t count = 0;
+			lanes[mask].fill(0);
+			for (uint32_t lane = 0; lane < 8; lane++) {
+				if (mask & (1u << lane)) {
+					lanes[mask][count++] = lane;
+				}
+			}
+			counts[mask] = count;
+		}
+	}
+};
+
+const CompactTable& compactTable() {
+	static const CompactTable table;
+	return table;
+}
+
+// Packs the indices of the visible ones of the 8 objects from first and writes
+// the 8 lanes, the extra ones are overwritten by the next batch (the output has
+// room for them). Returns how many were visible
+CULLER_TARGET_AVX2
+uint32_t packVisibleAvx2(const CompactTable& table, int mask, uint32_t first, uint32_t* visible) {
+	const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(table.lanes[mask].data()));
+	__m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first)), laneOffsets);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(visible), _mm256_permutevar8x32_epi32(indices, lanes));
+	return table.counts[mask];
+}
+
+// Same for 4 objects. Without a lane permute in SSE2 the packing is done one
+// index at a time
+uint32_t packVisibleSse(const CompactTable& table, int mask, uint32_t first, uint32_t* visible) {
+	const auto& lanes = table.lanes[mask];
+	for (uint32_t j = 0; j < 4; j++) {
+		visible[j] = first + lanes[j];
+	}
+	return table.counts[mask];
+}
+#endif
+
+// Box corners, one array per component
+struct BoxArrays {
+	const float* min[3];
+	const float* max[3];
+};
+
+// The p-vertex of a plane is the corner of a box furthest along its normal: on
+// every axis the max if the normal points that way, the min otherwise. It only
+// depends on the plane, so the arrays to read it from are picked once
+struct PVertexArrays {
+	const float* x[6];
+	const float* y[6];
+	const float* z[6];
+};
+
+PVertexArrays pVertexArrays(const Frustum& frustum, const BoxArrays& boxes) {
+	PVertexArrays arrays;
+	for (int p = 0; p < 6; p++) {
+		const glm::vec4& plane = frustum.planes[p];
+		arrays.x[p] = plane.x >= 0.0f ? boxes.max[0] : boxes.min[0];
+		arrays.y[p] = plane.y >= 0.0f ? boxes.max[1] : boxes.min[1];
+		arrays.z[p] = plane.z >= 0.0f ? boxes.max[2] : boxes.min[2];
+	}
+	return arrays;
+}
+
+#ifdef CULLER_X86
+
+CULLER_TARGET_AVX2
+uint32_t cullAvx2(const Frustum& frustum, const float* centerX, const float* centerY,
+	const float* centerZ, const float* radius, uint32_t first, uint32_t last, uint32_t* visible) {
+
+	const CompactTable& table = compactTable();
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	uint32_t count = 0;
+	for (uint32_t i = first; i < last; i += 8) {
+		__m256 x = _mm256_loadu_ps(centerX + i);
+		__m256 y = _mm256_loadu_ps(centerY + i);
+		__m256 z = _mm256_loadu_ps(centerZ + i);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+		// Same as the scalar test: inside while dot(plane, center) + w >= -radius
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_mul_ps(planeZ[p], z)), planeW[p]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+		count += packVisibleAvx2(table, _mm256_movemask_ps(inside), i, visible + count);
+	}
+	return count;
+}
+
+CULLER_TARGET_AVX2
+uint32_t cullBoxesAvx2(const Frustum& frustum, const PVertexArrays& vertices, uint32_t first,
+	uint32_t last, uint32_t* visible) {
+
+	const CompactTable& table = compactTable();
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	uint32_t count = 0;
+	for (uint32_t i = first; i < last; i += 8) {
+		// Inside while the p-vertex is on the inner side of every plane
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 x = _mm256_loadu_ps(vertices.x[p] + i);
+			__m256 y = _mm256_loadu_ps(vertices.y[p] + i);
+			__m256 z = _mm256_loadu_ps(vertices.z[p] + i);
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_mul_ps(planeZ[p], z)), planeW[p]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		count += packVisibleAvx2(table, _mm256_movemask_ps(inside), i, visible + count);
+	}
+	return count;
+}
+
+uint32_t cullSse(const Frustum& frustum, const float* centerX, const float* centerY,
+	const float* centerZ, const float* radius, uint32_t first, uint32_t last, uint32_t* visible) {
+
+	const CompactTable& table = compactTable();
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	uint32_t count = 0;
+	for (uint32_t i = first; i < last; i += 4) {
+		__m128 x = _mm_loadu_ps(centerX + i);
+		__m128 y = _mm_loadu_ps(centerY + i);
+		__m128 z = _mm_loadu_ps(centerZ + i);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_mul_ps(planeZ[p], z)), planeW[p]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+		count += packVisibleSse(table, _mm_movemask_ps(inside), i, visible + count);
+	}
+	return count;
+}
+
+uint32_t cullBoxesSse(const Frustum& frustum, const PVertexArrays& vertices, uint32_t first,
+	uint32_t last, uint32_t* visible) {
+
+	const CompactTable& table = compactTable();
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	uint32_t count = 0;
+	for (uint32_t i = first; i < last; i += 4) {
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 x = _mm_loadu_ps(vertices.x[p] + i);
+			__m128 y = _mm_loadu_ps(vertices.y[p] + i);
+			__m128 z = _mm_loadu_ps(vertices.z[p] + i);
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_mul_ps(planeZ[p], z)), planeW[p]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+		}
+		count += packVisibleSse(table, _mm_movemask_ps(inside), i, visible + count);
+	}
+	return count;
+}
+#endif
+
+uint32_t cullScalar(const Frustum& frustum, const float* centerX, const float* centerY,
+	const float* centerZ, const float* radius, uint32_t first, uint32_t last, uint32_t* visible) {
+
+	uint32_t count = 0;
+	for (uint32_t i = first; i < last; i++) {
+		bool inside = true;
+		for (const auto& plane : frustum.planes) {
+			float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+			inside = inside && distance >= -radius[i];
+		}
+		if (inside) {
+			visible[count++] = i;
+		}
+	}
+	return count;
+}
+
+uint32_t cullBoxesScalar(const Frustum& frustum, const PVertexArrays& vertices, uint32_t first,
+	uint32_t last, uint32_t* visible) {
+
+	uint32_t count = 0;
+	for (uint32_t i = first; i < last; i++) {
+		bool inside = true;
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = plane.x * vertices.x[p][i] + plane.y * vertices.y[p][i] +
+				plane.z * vertices.z[p][i] + plane.w;
+			inside = inside && distance >= 0.0f;
+		}
+		if (inside) {
+			visible[count++] = i;
+		}
+	}
+	return count;
+}
+
+uint32_t paddedSize(uint32_t size) {
+	return (size + 7) & ~7u;
+}
+
+}
+
+FrustumCuller::FrustumCuller() : m_path(bestPath()) {
+}
+
+void FrustumCuller::setSpheres(const std::vector<glm::vec4>& spheres) {
+	m_size = static_cast<uint32_t>(spheres.size());
+	uint32_t padded = paddedSize(m_size);
+	// The padding can never be visible: a negative radius bigger than any distance
+	m_centerX.assign(padded, 0.0f);
+	m_centerY.assign(padded, 0.0f);
+	m_centerZ.assign(padded, 0.0f);
+	m_radius.assign(padded, -FLT_MAX);
+	for (uint32_t i = 0; i < m_size; i++) {
+		m_centerX[i] = spheres[i].x;
+		m_centerY[i] = spheres[i].y;
+		m_centerZ[i] = spheres[i].z;
+		m_radius[i] = spheres[i].w;
+	}
+	m_boxes = false;
+}
+
+void FrustumCuller::setBoxes(const std::vector<Aabb>& boxes) {
+	m_size = static_cast<uint32_t>(boxes.size());
+	uint32_t padded = paddedSize(m_size);
+	// The padding can never be visible: inside out boxes, whatever corner is the
+	// p-vertex it is as far out as it gets
+	m_minX.assign(padded, FLT_MAX);
+	m_minY.assign(padded, FLT_MAX);
+	m_minZ.assign(padded, FLT_MAX);
+	m_maxX.assign(padded, -FLT_MAX);
+	m_maxY.assign(padded, -FLT_MAX);
+	m_maxZ.assign(padded, -FLT_MAX);
+	for (uint32_t i = 0; i < m_size; i++) {
+		m_minX[i] = boxes[i].min.x;
+		m_minY[i] = boxes[i].min.y;
+		m_minZ[i] = boxes[i].min.z;
+		m_maxX[i] = boxes[i].max.x;
+		m_maxY[i] = boxes[i].max.y;
+		m_maxZ[i] = boxes[i].max.z;
+	}
+	m_boxes = true;
+}
+
+uint32_t FrustumCuller::size() const {
+	return m_size;
+}
+
+uint32_t FrustumCuller::cullRange(const Frustum& frustum, uint32_t first, uint32_t last,
+	uint32_t* visible) const {
+
+	if (m_boxes) {
+		BoxArrays boxes = {
+			{ m_minX.data(), m_minY.data(), m_minZ.data() },
+			{ m_maxX.data(), m_maxY.data(), m_maxZ.data() }
+		};
+		PVertexArrays vertices = pVertexArrays(frustum, boxes);
+		switch (m_path) {
+#ifdef CULLER_X86
+		case Path::AVX2:
+			return cullBoxesAvx2(frustum, vertices, first, last, visible);
+		case Path::SSE:
+			return cullBoxesSse(frustum, vertices, first, last, visible);
+#endif
+		default:
+			return cullBoxesScalar(frustum, vertices, first, last, visible);
+		}
+	}
+	switch (m_path) {
+#ifdef CULLER_X86
+	case Path::AVX2:
+		return cullAvx2(frustum, m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+			m_radius.data(), first, last, visible);
+	case Path::SSE:
+		return cullSse(frustum, m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+			m_radius.data(), first, last, visible);
+#endif
+	default:
+		return cullScalar(frustum, m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+			m_radius.data(), first, last, visible);
+	}
+}
+
+void FrustumCuller::cull(const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool* pool) {
+	uint32_t padded = paddedSize(m_size);
+	uint32_t chunkCount = (padded + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	// The SIMD paths write whole batches, so the output needs room for 8 more
+	if (pool == nullptr || chunkCount <= 1) {
+		visible.resize(padded + 8);
+		visible.resize(cullRange(frustum, 0, padded, visible.data()));
+		return;
+	}
+
+	m_chunkVisible.resize(chunkCount);
+	std::vector<uint32_t> chunkCounts(chunkCount, 0);
+	auto cullChunk = [this, &frustum, &chunkCounts, padded](uint32_t chunk) {
+		uint32_t first = chunk * CHUNK_SIZE;
+		uint32_t last = std::min(first + CHUNK_SIZE, padded);
+		m_chunkVisible[chunk].resize(CHUNK_SIZE + 8);
+		chunkCounts[chunk] = cullRange(frustum, first, last, m_chunkVisible[chunk].data());
+	};
+	std::vector<std::future<void>> pending;
+	for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+		pending.push_back(pool->submit([cullChunk, chunk]() { cullChunk(chunk); }));
+	}
+	cullChunk(0);
+	for (auto& culling : pending) {
+		culling.get();
+	}
+	// Put the chunks together in order, so the list is the same as with one thread
+	uint32_t total = 0;
+	for (uint32_t count : chunkCounts) {
+		total += count;
+	}
+	visible.resize(total);
+	uint32_t offset = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+		std::memcpy(visible.data() + offset, m_chunkVisible[chunk].data(),
+			chunkCounts[chunk] * sizeof(uint32_t));
+		offset += chunkCounts[chunk];
+	}
+}
+
+FrustumCuller::Path FrustumCuller::path() const {
+	return m_path;
+}
+
+bool FrustumCuller::setPath(Path path) {
+	Path best = bestPath();
+	// Every path below the best one works too
+	if (static_cast<int>(path) > static_cast<int>(best)) {
+		return false;
+	}
+	m_path = path;
+	return true;
+}
+
+FrustumCuller::Path FrustumCuller::bestPath() {
+#ifdef CULLER_X86
+	// SSE2 is always there on x86-64 (and on any x86 we care about)
+	static const Path best = cpuHasAvx2() ? Path::AVX2 : Path::SSE;
+	return best;
+#else
+	return Path::Scalar;
+#endif
+}
+
+const char* FrustumCuller::pathName(Path path) {
+	switch (path) {
+	case Path::AVX2:
+		return "avx2";
+	case Path::SSE:
+		return "sse";
+	default:
+		return "scalar";
+	}
+}
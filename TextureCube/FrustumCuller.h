@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Culling.h"
+
+class ThreadPool;
+//! Culls large sets of bounding spheres or boxes against a view frustum on the CPU
+/*!
+  The objects are kept in SoA layout (one array per component), so a SIMD
+  register can load the same component of several objects at once: 8 with
+  AVX2, 4 with SSE. A box is tested against a plane by its p-vertex, the
+  corner furthest along the plane normal. The instruction set is picked at
+  runtime, with a plain scalar loop for the CPUs that have none of them. The
+  result is a compact list with the indices of the visible objects, sorted
+  from lowest to highest.
+*/
+class FrustumCuller {
+public:
+	//! Instruction sets the culling can run with
+	enum class Path {
+		Scalar,
+		SSE,
+		AVX2
+	};
+	//! Creates an empty culler, using the best path the CPU supports
+	FrustumCuller();
+	//! Replaces the objects with the given spheres (center in xyz, radius in w)
+	void setSpheres(const std::vector<glm::vec4>& spheres);
+	//! Replaces the objects with the given axis aligned boxes
+	void setBoxes(const std::vector<Aabb>& boxes);
+	//! Number of objects in the culler
+	uint32_t size() const;
+	//! Writes the indices of the objects that intersect the frustum in visible
+	/*!
+	  With a \class ThreadPool the objects are split in ranges culled in
+	  parallel, the calling thread takes the first one. The list ends up the
+	  same with or without threads
+	*/
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool* pool = nullptr);
+	//! The path the culling runs with
+	Path path() const;
+	//! Force a path (i.e. to compare them), returns false if the CPU can not run it
+	bool setPath(Path path);
+	//! Best path this CPU supports
+	static Path bestPath();
+	//! Printable name of a path
+	static const char* pathName(Path path);
+
+protected:
+	//! Culls the objects in [first, last), both multiple of 8, returns how many are visible
+	uint32_t cullRange(const Frustum& frustum, uint32_t first, uint32_t last,
+		uint32_t* visible) const;
+	//! Objects culled together by one thread, a multiple of 8
+	static constexpr uint32_t CHUNK_SIZE = 16384;
+	//! Path in use
+	Path m_path;
+	//! Are the objects boxes (or spheres)
+	bool m_boxes{ false };
+	//! Number of real objects (the arrays are padded to a multiple of 8)
+	uint32_t m_size{ 0 };
+	//! Sphere centers and radii, one array per component
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+	//! Box corners, one array per component
+	std::vector<float> m_minX;
+	std::vector<float> m_minY;
+	std::vector<float> m_minZ;
+	std::vector<float> m_maxX;
+	std::vector<float> m_maxY;
+	std::vector<float> m_maxZ;
+	//! Visible objects of every chunk, before putting them together
+	std::vector<std::vector<uint32_t>> m_chunkVisible;
+};
@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "GeometryPool.h"
+#include "Vertex.h"
+#include "TextureCubeApp.h"
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+	reset(capacity);
+}
+
+void RangeAllocator::reset(uint32_t capacity) {
+	m_freeRanges.clear();
+	m_capacity = capacity;
+	m_used = 0;
+	if (capacity > 0) {
+		m_freeRanges[0] = capacity;
+	}
+}
+
+std::optional<uint32_t> RangeAllocator::allocate(uint32_t size) {
+	if (size == 0) {
+		return std::nullopt;
+	}
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+		if (it->second < size) {
+			continue;
+		}
+		// Take the start of the free range, the rest stays free
+		uint32_t offset = it->first;
+		uint32_t remaining = it->second - size;
+		m_freeRanges.erase(it);
+		if (remaining > 0) {
+			m_freeRanges[offset + size] = remaining;
+		}
+		m_used += size;
+		return offset;
+	}
+	return std::nullopt;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+	if (size == 0) {
+		return;
+	}
+	m_used -= size;
+	auto next = m_freeRanges.lower_bound(offset);
+	// Merge with the free range right after...
+	if (next != m_freeRanges.end() && offset + size == next->first) {
+		size += next->second;
+		next = m_freeRanges.erase(next);
+	}
+	// ...and with the one right before
+	if (next != m_freeRanges.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			previous->second += size;
+			return;
+		}
+	}
+	m_freeRanges[offset] = size;
+}
+
+uint32_t RangeAllocator::capacity() const {
+	return m_capacity;
+}
+
+uint32_t RangeAllocator::used() const {
+	return m_used;
+}
+
+uint32_t RangeAllocator::largestFreeRange() const {
+	uint32_t largest = 0;
+	for (const auto& range : m_freeRanges) {
+		largest = std::max(largest, range.second);
+	}
+	return largest;
+}
+
+void TextureCubeApp::createGeometryPool() {
+	TRACE_FUNCTION();
+	createBuffer(sizeof(Vertex) * GEOMETRY_VERTEX_CAPACITY,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		mGeometryVertexBuffer, mGeometryVertexMemory, MemoryCategory::Mesh);
+	createBuffer(sizeof(uint32_t) * GEOMETRY_INDEX_CAPACITY,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		mGeometryIndexBuffer, mGeometryIndexMemory, MemoryCategory::Mesh);
+	mVertexRanges.reset(GEOMETRY_VERTEX_CAPACITY);
+	mIndexRanges.reset(GEOMETRY_INDEX_CAPACITY);
+	mMeshes.clear();
+}
+
+void TextureCubeApp::destroyGeometryPool() {
+	vkDestroyBuffer(mDevice, mGeometryIndexBuffer, mHostCallbacks);
+	freeMemory(mGeometryIndexMemory);
+	vkDestroyBuffer(mDevice, mGeometryVertexBuffer, mHostCallbacks);
+	freeMemory(mGeometryVertexMemory);
+	mMeshes.clear();
+}
+
+uint32_t TextureCubeApp::addMesh(const std::vector<Vertex>& vertices,
+	const std::vector<uint32_t>& indices) {
+	TRACE_FUNCTION();
+
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	uint32_t indexCount = static_cast<uint32_t>(indices.size());
+	std::optional<uint32_t> firstVertex = mVertexRanges.allocate(vertexCount);
+	std::optional<uint32_t> firstIndex = mIndexRanges.allocate(indexCount);
+	if (!firstVertex.has_value() || !firstIndex.has_value()) {
+		// Give back whatever we got, it might fit once the holes are gone
+		if (firstVertex.has_value()) {
+			mVertexRanges.free(firstVertex.value(), vertexCount);
+		}
+		if (firstIndex.has_value()) {
+			mIndexRanges.free(firstIndex.value(), indexCount);
+		}
+		if (mVertexRanges.capacity() - mVertexRanges.used() < vertexCount ||
+			mIndexRanges.capacity() - mIndexRanges.used() < indexCount) {
+			throw std::runtime_error("geometry pool is full!");
+		}
+		compactGeometryPool();
+		firstVertex = mVertexRanges.allocate(vertexCount);
+		firstIndex = mIndexRanges.allocate(indexCount);
+	}
+
+	MeshRange mesh{};
+	mesh.firstVertex = firstVertex.value();
+	mesh.vertexCount = vertexCount;
+	mesh.firstIndex = firstIndex.value();
+	mesh.indexCount = indexCount;
+	mesh.live = true;
+	// Only the ranges of this mesh are written, the rest of the pool can be in use
+	UploadBatch upload = beginUpload();
+	uploadBuffer(upload, vertices.data(), sizeof(Vertex) * vertexCount, mGeometryVertexBuffer,
+		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		sizeof(Vertex) * mesh.firstVertex);
+	uploadBuffer(upload, indices.data(), sizeof(uint32_t) * indexCount, mGeometryIndexBuffer,
+		VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		sizeof(uint32_t) * mesh.firstIndex);
+	submitUpload(upload);
+
+	mMeshes.push_back(mesh);
+	return static_cast<uint32_t>(mMeshes.size() - 1);
+}
+
+void TextureCubeApp::removeMesh(uint32_t mesh) {
+	MeshRange& range = mMeshes.at(mesh);
+	if (!range.live) {
+		return;
+	}
+	// A frame in flight may still draw it, and a new mesh may be uploaded
+	// over its ranges right away
+	vkDeviceWaitIdle(mDevice);
+	mVertexRanges.free(range.firstVertex, range.vertexCount);
+	mIndexRanges.free(range.firstIndex, range.indexCount);
+	range.live = false;
+}
+
+void TextureCubeApp::compactGeometryPool() {
+	// Everything moves, nobody may be reading the pool
+	vkDeviceWaitIdle(mDevice);
+
+	// The live meshes are copied packed into a new pair of buffers. Copying
+	// inside the same buffer would need the ranges to never overlap
+	VkBuffer vertexBuffer;
+	VkDeviceMemory vertexMemory;
+	VkBuffer indexBuffer;
+	VkDeviceMemory indexMemory;
+	createBuffer(sizeof(Vertex) * GEOMETRY_VERTEX_CAPACITY,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		vertexBuffer, vertexMemory, MemoryCategory::Mesh);
+	createBuffer(sizeof(uint32_t) * GEOMETRY_INDEX_CAPACITY,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		indexBuffer, indexMemory, MemoryCategory::Mesh);
+
+	mVertexRanges.reset(GEOMETRY_VERTEX_CAPACITY);
+	mIndexRanges.reset(GEOMETRY_INDEX_CAPACITY);
+	std::vector<VkBufferCopy> vertexCopies;
+	std::vector<VkBufferCopy> indexCopies;
+	for (auto& mesh : mMeshes) {
+		if (!mesh.live) {
+			continue;
+		}
+		// Allocating in order from an empty pool packs them one after the other
+		uint32_t firstVertex = mVertexRanges.allocate(mesh.vertexCount).value();
+		uint32_t firstIndex = mIndexRanges.allocate(mesh.indexCount).value();
+		vertexCopies.push_back({ sizeof(Vertex) * mesh.firstVertex,
+			sizeof(Vertex) * firstVertex, sizeof(Vertex) * mesh.vertexCount });
+		indexCopies.push_back({ sizeof(uint32_t) * mesh.firstIndex,
+			sizeof(uint32_t) * firstIndex, sizeof(uint32_t) * mesh.indexCount });
+		mesh.firstVertex = firstVertex;
+		mesh.firstIndex = firstIndex;
+	}
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	if (!vertexCopies.empty()) {
+		vkCmdCopyBuffer(commandBuffer, mGeometryVertexBuffer, vertexBuffer,
+			static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+		vkCmdCopyBuffer(commandBuffer, mGeometryIndexBuffer, indexBuffer,
+			static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+	}
+	endSingleTimeCommands(commandBuffer);
+
+	vkDestroyBuffer(mDevice, mGeometryIndexBuffer, mHostCallbacks);
+	freeMemory(mGeometryIndexMemory);
+	vkDestroyBuffer(mDevice, mGeometryVertexBuffer, mHostCallbacks);
+	freeMemory(mGeometryVertexMemory);
+	mGeometryVertexBuffer = vertexBuffer;
+	mGeometryVertexMemory = vertexMemory;
+	mGeometryIndexBuffer = indexBuffer;
+	mGeometryIndexMemory = indexMemory;
+}
+
+void TextureCubeApp::logGeometryStats() {
+	uint32_t liveMeshes = 0;
+	for (const auto& mesh : mMeshes) {
+		liveMeshes += mesh.live ? 1 : 0;
+	}
+	std::cout << "[geometry] " << liveMeshes << " meshes | vertices " << mVertexRanges.used()
+		<< "/" << mVertexRanges.capacity() << " (largest free " << mVertexRanges.largestFreeRange()
+		<< ") | indices " << mIndexRanges.used() << "/" << mIndexRanges.capacity()
+		<< " (largest free " << mIndexRanges.largestFreeRange() << ")" << std::endl;
+}
+
+void TextureCubeApp::verifyGeometryPool() {
+	int failures = 0;
+	auto check = [&failures](bool passed, const std::string& what) {
+		if (!passed) {
+			failures++;
+		}
+		std::cout << "[geometry] " << what << " " << (passed ? "ok" : "MISMATCH") << std::endl;
+	};
+
+	// The allocator alone: three ranges freed so that they merge with the range
+	// after, with the one before, and with both
+	RangeAllocator ranges(100);
+	uint32_t first = ranges.allocate(10).value();
+	uint32_t second = ranges.allocate(20).value();
+	uint32_t third = ranges.allocate(30).value();
+	check(first == 0 && second == 10 && third == 30, "first fit offsets");
+	ranges.free(second, 20);
+	check(ranges.used() == 40 && ranges.largestFreeRange() == 40, "free in the middle");
+	ranges.free(first, 10);
+	// The two holes are one now, so it fits right at the start
+	check(ranges.allocate(30) == std::optional<uint32_t>(0), "merge with the next range");
+	ranges.free(0, 30);
+	ranges.free(third, 30);
+	check(ranges.used() == 0 && ranges.largestFreeRange() == 100, "merge with both ranges");
+
+	// The pool: three meshes after the scene, the middle one removed, then
+	// everything compacted and read back at the new ranges
+	auto makeMesh = [](uint32_t seed, uint32_t vertexCount, std::vector<Vertex>& vertices,
+		std::vector<uint32_t>& indices) {
+		vertices.assign(vertexCount, Vertex{});
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			vertices[i].pos = glm::vec3(static_cast<float>(seed), static_cast<float>(i), 0.0f);
+		}
+		indices.resize(3 * vertexCount);
+		for (uint32_t i = 0; i < indices.size(); i++) {
+			indices[i] = (7 * i + seed) % vertexCount;
+		}
+	};
+	auto readBack = [this](VkBuffer source, VkDeviceSize offset, VkDeviceSize size) {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer, memory, MemoryCategory::Staging);
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		VkBufferCopy region{ offset, 0, size };
+		vkCmdCopyBuffer(commandBuffer, source, buffer, 1, &region);
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		endSingleTimeCommands(commandBuffer);
+		std::vector<uint8_t> data(static_cast<size_t>(size));
+		void* mapped;
+		vkMapMemory(mDevice, memory, 0, size, 0, &mapped);
+		memcpy(data.data(), mapped, data.size());
+		vkUnmapMemory(mDevice, memory);
+		vkDestroyBuffer(mDevice, buffer, mHostCallbacks);
+		freeMemory(memory);
+		return data;
+	};
+
+	const uint32_t MESH_SIZES[] = { 64, 128, 32 };
+	std::vector<std::vector<Vertex>> vertices(3);
+	std::vector<std::vector<uint32_t>> indices(3);
+	std::vector<uint32_t> meshes(3);
+	for (uint32_t i = 0; i < 3; i++) {
+		makeMesh(i + 1, MESH_SIZES[i], vertices[i], indices[i]);
+		meshes[i] = addMesh(vertices[i], indices[i]);
+	}
+	removeMesh(meshes[1]);
+	uint32_t holeStart = mMeshes[meshes[1]].firstVertex;
+	compactGeometryPool();
+
+	// The live meshes are packed in order from the start, with nothing left in between
+	uint32_t nextVertex = 0;
+	uint32_t nextIndex = 0;
+	bool packed = true;
+	for (const auto& mesh : mMeshes) {
+		if (!mesh.live) {
+			continue;
+		}
+		packed = packed && mesh.firstVertex == nextVertex && mesh.firstIndex == nextIndex;
+		nextVertex += mesh.vertexCount;
+		nextIndex += mesh.indexCount;
+	}
+	check(packed && mVertexRanges.used() == nextVertex && mIndexRanges.used() == nextIndex,
+		"packed ranges after compaction");
+	check(mMeshes[meshes[2]].firstVertex == holeStart, "last mesh moved into the hole");
+	// Same bytes at the new offsets, so firstIndex and vertexOffset still draw the same mesh
+	for (uint32_t i : { 0u, 2u }) {
+		const MeshRange& mesh = mMeshes[meshes[i]];
+		std::vector<uint8_t> vertexData = readBack(mGeometryVertexBuffer,
+			sizeof(Vertex) * mesh.firstVertex, sizeof(Vertex) * mesh.vertexCount);
+		std::vector<uint8_t> indexData = readBack(mGeometryIndexBuffer,
+			sizeof(uint32_t) * mesh.firstIndex, sizeof(uint32_t) * mesh.indexCount);
+		check(memcmp(vertexData.data(), vertices[i].data(), vertexData.size()) == 0 &&
+			memcmp(indexData.data(), indices[i].data(), indexData.size()) == 0,
+			"contents of mesh " + std::to_string(meshes[i]));
+	}
+	removeMesh(meshes[0]);
+	removeMesh(meshes[2]);
+	logGeometryStats();
+
+	if (failures > 0) {
+		throw std::runtime_error("geometry pool verification failed in " +
+			std::to_string(failures) + " checks!");
+	}
+	std::cout << "[geometry] verification passed" << std::endl;
+}
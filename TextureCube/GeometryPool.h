@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+
+//! Hands out ranges of a fixed size space, like the elements of a buffer
+/*!
+  Keeps the free ranges sorted by offset and takes the first one big enough
+  for every allocation. Freed ranges are merged with their free neighbours,
+  so the space only fragments when ranges in the middle stay allocated.
+  Sizes and offsets are in elements (vertices, indices...), not in bytes.
+*/
+class RangeAllocator {
+public:
+	//! Creates an allocator with the given number of elements, all free
+	explicit RangeAllocator(uint32_t capacity = 0);
+	//! Frees everything and changes the capacity
+	void reset(uint32_t capacity);
+	//! Offset of a new range of the given size, or nothing if no free range fits
+	std::optional<uint32_t> allocate(uint32_t size);
+	//! Returns a range given by \fn allocate
+	void free(uint32_t offset, uint32_t size);
+	//! Total number of elements
+	uint32_t capacity() const;
+	//! Elements in allocated ranges
+	uint32_t used() const;
+	//! Biggest allocation that would succeed right now
+	uint32_t largestFreeRange() const;
+
+protected:
+	//! Free ranges, offset to size
+	std::map<uint32_t, uint32_t> m_freeRanges;
+	//! Total number of elements
+	uint32_t m_capacity{ 0 };
+	//! Elements in allocated ranges
+	uint32_t m_used{ 0 };
+};
+
+// Where a mesh lives inside the shared vertex and index buffers
+struct MeshRange {
+	uint32_t firstVertex{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t firstIndex{ 0 };
+	uint32_t indexCount{ 0 };
+	// False once the mesh is removed, its id is not reused
+	bool live{ false };
+};
@@ -0,0 +1,193 @@
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "Culling.h"
+#include "TextureCubeApp.h"
+
+void TextureCubeApp::createCullingResources() {
+	TRACE_FUNCTION();
+	VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * mInstances.size();
+	// Every frame in flight writes its own draws, the GPU may still read the previous ones
+	for (auto& frame : mFrames) {
+		createBuffer(drawsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawCommandBuffer, frame.drawCommandMemory,
+			MemoryCategory::Mesh);
+		createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			frame.drawCountBuffer, frame.drawCountMemory, MemoryCategory::Mesh);
+		createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.visibleCountBuffer, frame.visibleCountMemory, MemoryCategory::Staging);
+		// Stays mapped, it is read once the frame is done
+		vkMapMemory(mDevice, frame.visibleCountMemory, 0, sizeof(uint32_t), 0,
+			reinterpret_cast<void**>(&frame.visibleCount));
+		*frame.visibleCount = 0;
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = static_cast<uint32_t>(3 * mFrames.size());
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = static_cast<uint32_t>(mFrames.size());
+
+	if (vkCreateDescriptorPool(mDevice, &poolInfo, mHostCallbacks, &mCullingDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor pool!");
+	}
+
+	for (auto& frame : mFrames) {
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = mCullingDescriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &mCullingSetLayout;
+
+		if (vkAllocateDescriptorSets(mDevice, &allocInfo, &frame.cullingSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate culling descriptor sets!");
+		}
+
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+		bufferInfos[0].buffer = mBoundsBuffer;
+		bufferInfos[0].range = VK_WHOLE_SIZE;
+		bufferInfos[1].buffer = frame.drawCommandBuffer;
+		bufferInfos[1].range = VK_WHOLE_SIZE;
+		bufferInfos[2].buffer = frame.drawCountBuffer;
+		bufferInfos[2].range = VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+		for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = frame.cullingSet;
+			descriptorWrites[i].dstBinding = i; // As described in the shader
+			descriptorWrites[i].dstArrayElement = 0;
+			descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[i].descriptorCount = 1;
+			descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()),
+			descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void TextureCubeApp::destroyCullingResources() {
+	// The sets go away with their pool
+	vkDestroyDescriptorPool(mDevice, mCullingDescriptorPool, mHostCallbacks);
+	for (auto& frame : mFrames) {
+		vkDestroyBuffer(mDevice, frame.drawCommandBuffer, mHostCallbacks);
+		freeMemory(frame.drawCommandMemory);
+		vkDestroyBuffer(mDevice, frame.drawCountBuffer, mHostCallbacks);
+		freeMemory(frame.drawCountMemory);
+		vkUnmapMemory(mDevice, frame.visibleCountMemory);
+		vkDestroyBuffer(mDevice, frame.visibleCountBuffer, mHostCallbacks);
+		freeMemory(frame.visibleCountMemory);
+		frame.visibleCount = nullptr;
+	}
+}
+
+void TextureCubeApp::recordCulling(FrameContext& frame, uint32_t objectCount) {
+	VkCommandBuffer commandBuffer = frame.primary.commandBuffer;
+	// Nothing is visible until the shader says so
+	vkCmdFillBuffer(commandBuffer, frame.drawCountBuffer, 0, sizeof(uint32_t), 0);
+
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	// Same planes the CPU would test against, in the space of the bounds
+	CullingPushConstants constants{};
+	for (size_t i = 0; i < mFrustum.planes.size(); i++) {
+		constants.planes[i] = mFrustum.planes[i];
+	}
+	constants.objectCount = objectCount;
+	const MeshRange& mesh = mMeshes[mSceneMesh];
+	constants.indexCount = mesh.indexCount;
+	constants.firstIndex = mesh.firstIndex;
+	constants.vertexOffset = static_cast<int32_t>(mesh.firstVertex);
+	frame.frustum = mFrustum;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullingPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+		mCullingPipelineLayout, 0, 1, &frame.cullingSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, mCullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+		0, sizeof(constants), &constants);
+	// One invocation per object, 64 per group as in the shader
+	vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+
+	// The draws are read as indirect arguments, the count is also copied back
+	VkMemoryBarrier cullBarrier{};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.size = sizeof(uint32_t);
+	vkCmdCopyBuffer(commandBuffer, frame.drawCountBuffer, frame.visibleCountBuffer, 1, &copyRegion);
+
+	VkMemoryBarrier readbackBarrier{};
+	readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+}
+
+void TextureCubeApp::verifyCulling() {
+	if (!mGpuCulling) {
+		throw std::runtime_error("gpu culling is not supported by this device!");
+	}
+	// Looking from wide to narrow, so more and more of the grid is culled
+	const int FIRST_ZOOM = 5;
+	const int LAST_ZOOM = -5;
+	// Spheres this close to a plane may land on either side due to rounding
+	const float MARGIN_EPSILON = 1e-4f;
+
+	int failures = 0;
+	for (int zoom = FIRST_ZOOM; zoom >= LAST_ZOOM; zoom--) {
+		mZoomLevel = zoom;
+		drawFrame();
+		// Wait for the frame and read what the GPU counted
+		vkDeviceWaitIdle(mDevice);
+		size_t lastFrame = (mCurrentFrame + mFrames.size() - 1) % mFrames.size();
+		const FrameContext& frame = mFrames[lastFrame];
+		uint32_t gpuCount = *frame.visibleCount;
+		// Same test on the CPU, with the planes the frame used
+		uint32_t cpuCount = 0;
+		uint32_t ambiguous = 0;
+		for (const auto& sphere : mInstanceBounds) {
+			if (frame.frustum.intersectsSphere(sphere)) {
+				cpuCount++;
+			}
+			if (frame.frustum.sphereMargin(sphere) < MARGIN_EPSILON) {
+				ambiguous++;
+			}
+		}
+		uint32_t difference = gpuCount > cpuCount ? gpuCount - cpuCount : cpuCount - gpuCount;
+		bool passed = difference <= ambiguous;
+		if (!passed) {
+			failures++;
+		}
+		std::cout << "[culling] zoom " << zoom << ": gpu " << gpuCount << ", cpu " << cpuCount
+			<< " of " << mInstanceBounds.size() << " (" << ambiguous << " on the edge) "
+			<< (passed ? "ok" : "MISMATCH") << std::endl;
+	}
+	mZoomLevel = 0;
+
+	if (failures > 0) {
+		throw std::runtime_error("gpu culling verification failed in " +
+			std::to_string(failures) + " frames!");
+	}
+	std::cout << "[culling] verification passed" << std::endl;
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "GpuProfiler.h"
+
+GpuProfiler::GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+	uint32_t slotCount, uint32_t maxScopes, bool hostReset, const VkAllocationCallbacks* allocator) :
+	m_device(device), m_allocator(allocator), m_maxScopes(maxScopes), m_hostReset(hostReset) {
+
+	// Timestamps only count ticks, the device tells how long one is and how many bits are valid
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+	uint32_t validBits = queueFamilies[queueFamily].timestampValidBits;
+	if (validBits == 0) {
+		return;
+	}
+	// Without the host reset the queries are reset in the command buffer, and a
+	// transfer only queue can not record that
+	VkQueueFlags resetQueues = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+	if (!m_hostReset && (queueFamilies[queueFamily].queueFlags & resetQueues) == 0) {
+		return;
+	}
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_timestampPeriod = properties.limits.timestampPeriod;
+	m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * m_maxScopes;
+	m_slots.resize(slotCount);
+	for (auto& slot : m_slots) {
+		if (vkCreateQueryPool(m_device, &queryPoolInfo, m_allocator, &slot.queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+	}
+}
+
+GpuProfiler::~GpuProfiler() {
+	for (auto& slot : m_slots) {
+		vkDestroyQueryPool(m_device, slot.queryPool, m_allocator);
+	}
+}
+
+bool GpuProfiler::enabled() const {
+	return !m_slots.empty();
+}
+
+bool GpuProfiler::beginSlot(VkCommandBuffer commandBuffer, uint32_t slot) {
+	if (!enabled() || m_slots[slot].state == SlotState::Submitted) {
+		return false;
+	}
+	Slot& current = m_slots[slot];
+	// The slot was collected (or never submitted), the GPU is done with its queries
+	if (m_hostReset) {
+		vkResetQueryPool(m_device, current.queryPool, 0, 2 * m_maxScopes);
+	} else {
+		vkCmdResetQueryPool(commandBuffer, current.queryPool, 0, 2 * m_maxScopes);
+	}
+	current.names.clear();
+	current.state = SlotState::Recording;
+	return true;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, uint32_t slot,
+	const std::string& name, VkPipelineStageFlagBits stage) {
+
+	if (!enabled() || m_slots[slot].state != SlotState::Recording ||
+		m_slots[slot].names.size() >= m_maxScopes) {
+		return NO_SCOPE;
+	}
+	Slot& current = m_slots[slot];
+	uint32_t scope = static_cast<uint32_t>(current.names.size());
+	current.names.push_back(name);
+	vkCmdWriteTimestamp(commandBuffer, stage, current.queryPool, 2 * scope);
+	return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope,
+	VkPipelineStageFlagBits stage) {
+
+	if (scope == NO_SCOPE) {
+		return;
+	}
+	vkCmdWriteTimestamp(commandBuffer, stage, m_slots[slot].queryPool, 2 * scope + 1);
+}
+
+void GpuProfiler::submitSlot(uint32_t slot) {
+	if (!enabled() || m_slots[slot].state != SlotState::Recording) {
+		return;
+	}
+	// Nothing written, nothing to wait for
+	m_slots[slot].state = m_slots[slot].names.empty() ? SlotState::Idle : SlotState::Submitted;
+}
+
+bool GpuProfiler::collect(uint32_t slot, std::vector<GpuScopeTime>& scopes) {
+	scopes.clear();
+	if (!enabled() || m_slots[slot].state != SlotState::Submitted) {
+		return false;
+	}
+	Slot& current = m_slots[slot];
+	current.state = SlotState::Idle;
+	// The caller waited for the commands, so the results are there (no need to wait)
+	uint32_t queryCount = static_cast<uint32_t>(2 * current.names.size());
+	std::vector<uint64_t> timestamps(queryCount);
+	if (vkGetQueryPoolResults(m_device, current.queryPool, 0, queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return false;
+	}
+	for (size_t i = 0; i < current.names.size(); i++) {
+		uint64_t begin = timestamps[2 * i] & m_timestampMask;
+		uint64_t end = timestamps[2 * i + 1] & m_timestampMask;
+		// The counter may wrap around between the two
+		uint64_t ticks = (end - begin) & m_timestampMask;
+		double ms = static_cast<double>(ticks) * m_timestampPeriod / 1e6;
+		scopes.push_back({ current.names[i], ms });
+
+		GpuScopeStats& stats = m_totals[current.names[i]];
+		stats.count++;
+		stats.totalMs += ms;
+		stats.lastMs = ms;
+		stats.maxMs = std::max(stats.maxMs, ms);
+	}
+	return true;
+}
+
+const std::map<std::string, GpuScopeStats>& GpuProfiler::totals() const {
+	return m_totals;
+}
+
+void GpuProfiler::resetTotals() {
+	m_totals.clear();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+//! GPU time of a scope, read back from its pair of timestamps
+struct GpuScopeTime {
+	std::string name;
+	double ms;
+};
+
+//! Everything a scope took since the totals were reset
+struct GpuScopeStats {
+	uint32_t count{ 0 };
+	double totalMs{ 0.0 };
+	double lastMs{ 0.0 };
+	double maxMs{ 0.0 };
+};
+
+//! Measures scopes of GPU work with timestamp queries
+/*!
+  The profiler owns a ring of slots, each with its own query pool. A slot
+  holds the scopes of work that is submitted (and completes) together, like
+  the commands of a frame in flight or an upload batch. The caller knows when
+  that work is done (a fence, a timeline value) and only then collects the
+  slot, so reading the results never waits. A scope is a pair of timestamps,
+  written with \fn beginScope and \fn endScope in the same queue.
+  The queries are reset from the host when the device can (hostQueryReset),
+  otherwise in the command buffer, which only graphics and compute queues
+  allow. Queues that can not write timestamps (or reset them) get a disabled
+  profiler, where every call does nothing.
+*/
+class GpuProfiler {
+public:
+	//! Returned by \fn beginScope when the scope is not measured
+	static constexpr uint32_t NO_SCOPE = UINT32_MAX;
+	//! Creates the query pools for the queues of the given family
+	/*!
+	  hostReset tells that the device was created with hostQueryReset enabled
+	*/
+	GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+		uint32_t slotCount, uint32_t maxScopes, bool hostReset,
+		const VkAllocationCallbacks* allocator = nullptr);
+	~GpuProfiler();
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+	//! Can the queue family write (and reset) timestamps at all
+	bool enabled() const;
+	//! Starts the scopes of a slot, resetting its queries
+	/*!
+	  Called before any scope of the slot, outside of a render pass, once the
+	  previous commands of the slot are completed. Returns false (and the slot
+	  is not measured) if the previous scopes of the slot were submitted and
+	  not collected yet
+	*/
+	bool beginSlot(VkCommandBuffer commandBuffer, uint32_t slot);
+	//! Writes the starting timestamp of a scope, returns its index in the slot
+	uint32_t beginScope(VkCommandBuffer commandBuffer, uint32_t slot, const std::string& name,
+		VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	//! Writes the ending timestamp of a scope
+	void endScope(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t scope,
+		VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	//! Lets the profiler know the commands of the slot were submitted
+	void submitSlot(uint32_t slot);
+	//! Reads the scopes of a submitted slot, once its commands are completed
+	/*!
+	  Returns false if there was nothing to read. The times are also added to
+	  the totals of their scope
+	*/
+	bool collect(uint32_t slot, std::vector<GpuScopeTime>& scopes);
+	//! Totals of every scope collected so far, by name
+	const std::map<std::string, GpuScopeStats>& totals() const;
+	void resetTotals();
+
+protected:
+	enum class SlotState { Idle, Recording, Submitted };
+	struct Slot {
+		VkQueryPool queryPool{ VK_NULL_HANDLE };
+		SlotState state{ SlotState::Idle };
+		//! Names of the scopes begun so far, two queries each
+		std::vector<std::string> names;
+	};
+	VkDevice m_device;
+	const VkAllocationCallbacks* m_allocator;
+	//! Nanoseconds per tick and the bits of the timestamps that are valid
+	float m_timestampPeriod{ 0.0f };
+	uint64_t m_timestampMask{ 0 };
+	uint32_t m_maxScopes;
+	bool m_hostReset;
+	std::vector<Slot> m_slots;
+	std::map<std::string, GpuScopeStats> m_totals;
+};
@@ -0,0 +1,65 @@
+#include <iostream>
+
+#include "TextureCubeApp.h"
+
+void TextureCubeApp::createOffscreenImages() {
+	// Stand in for the swapchain: same format and count the windowed mode would
+	// usually get, so the render pass and the per image resources do not change
+	mSwapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+	mSwapChainExtent = { mWidth, mHeight };
+	mSwapChainImages.resize(OFFSCREEN_IMAGE_COUNT);
+	mOffscreenMemories.resize(OFFSCREEN_IMAGE_COUNT);
+	for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; i++) {
+		// Transfer source too, to read the frames back, and destination for the upscale
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		if (mDynamicResolution) {
+			usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		}
+		createImage(mWidth, mHeight, 1, VK_SAMPLE_COUNT_1_BIT, mSwapChainImageFormat,
+			VK_IMAGE_TILING_OPTIMAL, usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mSwapChainImages[i], mOffscreenMemories[i],
+			MemoryCategory::Attachment);
+	}
+	mOffscreenImage = 0;
+}
+
+void TextureCubeApp::destroyOffscreenImages() {
+	for (size_t i = 0; i < mSwapChainImages.size(); i++) {
+		vkDestroyImage(mDevice, mSwapChainImages[i], mHostCallbacks);
+		freeMemory(mOffscreenMemories[i]);
+	}
+	mSwapChainImages.clear();
+	mOffscreenMemories.clear();
+}
+
+uint32_t TextureCubeApp::acquireOffscreenImage() {
+	// Round robin. A frame still in flight may be drawing to it too, but nobody
+	// reads the images and the render passes on the queue go one after the other
+	uint32_t imageIndex = mOffscreenImage;
+	mOffscreenImage = (mOffscreenImage + 1) % OFFSCREEN_IMAGE_COUNT;
+	return imageIndex;
+}
+
+void TextureCubeApp::logHeadlessDevice() {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	const char* type = "other";
+	switch (properties.deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		type = "discrete gpu";
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		type = "integrated gpu";
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		type = "virtual gpu";
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		type = "cpu";
+		break;
+	default:
+		break;
+	}
+	std::cout << "[headless] rendering " << mWidth << "x" << mHeight << " offscreen on "
+		<< properties.deviceName << " (" << type << ")" << std::endl;
+}
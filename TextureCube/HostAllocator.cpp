@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "HostAllocator.h"
+
+// Chunks are aligned to their size, so the chunk of a block is its address rounded down
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+static constexpr size_t MIN_BLOCK_SIZE = 16;
+
+const char* hostScopeName(HostScope scope) {
+	switch (scope) {
+	case HostScope::Command:
+		return "command";
+	case HostScope::Object:
+		return "object";
+	case HostScope::Device:
+		return "device";
+	default:
+		return "unknown";
+	}
+}
+
+HostAllocator::HostAllocator() {
+	m_callbacks.pUserData = this;
+	m_callbacks.pfnAllocation = &HostAllocator::allocationCallback;
+	m_callbacks.pfnReallocation = &HostAllocator::reallocationCallback;
+	m_callbacks.pfnFree = &HostAllocator::freeCallback;
+	m_callbacks.pfnInternalAllocation = &HostAllocator::internalAllocationCallback;
+	m_callbacks.pfnInternalFree = &HostAllocator::internalFreeCallback;
+}
+
+HostAllocator::~HostAllocator() {
+	for (const auto& chunk : m_chunks) {
+		::operator delete(reinterpret_cast<void*>(chunk.first), std::align_val_t(CHUNK_SIZE));
+	}
+	// Nothing should be left, unless something was never destroyed
+	for (const auto& allocation : m_largeAllocations) {
+		::operator delete(allocation.first, std::align_val_t(allocation.second.alignment));
+	}
+}
+
+const VkAllocationCallbacks* HostAllocator::callbacks() const {
+	return &m_callbacks;
+}
+
+HostAllocationStats HostAllocator::stats() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+size_t HostAllocator::sizeClassBytes(size_t sizeClass) {
+	return MIN_BLOCK_SIZE << sizeClass;
+}
+
+HostScope HostAllocator::toHostScope(VkSystemAllocationScope scope) {
+	switch (scope) {
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+		return HostScope::Command;
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+	case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+		return HostScope::Object;
+	default:
+		return HostScope::Device;
+	}
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocationCallback(void* userData, size_t size,
+	size_t alignment, VkSystemAllocationScope scope) {
+
+	auto allocator = static_cast<HostAllocator*>(userData);
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	return allocator->allocate(size, alignment, toHostScope(scope));
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocationCallback(void* userData, void* original,
+	size_t size, size_t alignment, VkSystemAllocationScope scope) {
+
+	auto allocator = static_cast<HostAllocator*>(userData);
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	return allocator->reallocate(original, size, alignment, toHostScope(scope));
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::freeCallback(void* userData, void* memory) {
+	auto allocator = static_cast<HostAllocator*>(userData);
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalAllocationCallback(void* userData, size_t size,
+	VkInternalAllocationType type, VkSystemAllocationScope scope) {
+
+	auto allocator = static_cast<HostAllocator*>(userData);
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_stats.internalBytes[static_cast<size_t>(toHostScope(scope))] += size;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalFreeCallback(void* userData, size_t size,
+	VkInternalAllocationType type, VkSystemAllocationScope scope) {
+
+	auto allocator = static_cast<HostAllocator*>(userData);
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_stats.internalBytes[static_cast<size_t>(toHostScope(scope))] -= size;
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, HostScope scope) {
+	if (size == 0) {
+		return nullptr;
+	}
+	size_t index = static_cast<size_t>(scope);
+	// Blocks are aligned to their size, so a big alignment just needs a bigger class
+	size_t needed = std::max({ size, alignment, MIN_BLOCK_SIZE });
+	size_t sizeClass = 0;
+	while (sizeClass < HOST_SIZE_CLASS_COUNT && sizeClassBytes(sizeClass) < needed) {
+		sizeClass++;
+	}
+
+	void* memory = nullptr;
+	size_t bytes = 0;
+	if (sizeClass == HOST_LARGE_CLASS) {
+		alignment = std::max(alignment, alignof(std::max_align_t));
+		memory = ::operator new(size, std::align_val_t(alignment), std::nothrow);
+		if (memory == nullptr) {
+			return nullptr;
+		}
+		m_largeAllocations[memory] = LargeAllocation{ scope, size, alignment };
+		bytes = size;
+	} else {
+		void*& freeList = m_arenas[index].freeLists[sizeClass];
+		bytes = sizeClassBytes(sizeClass);
+		if (freeList == nullptr) {
+			// Carve a new chunk into blocks of this class, chained in address order
+			auto chunk = static_cast<char*>(::operator new(CHUNK_SIZE, std::align_val_t(CHUNK_SIZE),
+				std::nothrow));
+			if (chunk == nullptr) {
+				return nullptr;
+			}
+			m_chunks[reinterpret_cast<uintptr_t>(chunk)] = Chunk{ scope, sizeClass };
+			m_stats.chunkBytes += CHUNK_SIZE;
+			for (size_t offset = CHUNK_SIZE; offset >= bytes; offset -= bytes) {
+				void* block = chunk + offset - bytes;
+				*static_cast<void**>(block) = freeList;
+				freeList = block;
+			}
+		}
+		memory = freeList;
+		freeList = *static_cast<void**>(memory);
+	}
+
+	m_stats.allocations[index]++;
+	m_stats.sizeClasses[index][sizeClass]++;
+	m_stats.liveBytes[index] += bytes;
+	m_stats.peakBytes[index] = std::max(m_stats.peakBytes[index], m_stats.liveBytes[index]);
+	return memory;
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, HostScope scope) {
+	if (original == nullptr) {
+		return allocate(size, alignment, scope);
+	}
+	if (size == 0) {
+		free(original);
+		return nullptr;
+	}
+	m_stats.reallocations[static_cast<size_t>(scope)]++;
+	size_t oldSize = 0;
+	auto chunk = m_chunks.find(reinterpret_cast<uintptr_t>(original) & ~(CHUNK_SIZE - 1));
+	if (chunk != m_chunks.end()) {
+		oldSize = sizeClassBytes(chunk->second.sizeClass);
+		// The block is aligned to its size, so it may be big enough already
+		if (size <= oldSize && alignment <= oldSize) {
+			return original;
+		}
+	} else {
+		oldSize = m_largeAllocations.at(original).size;
+	}
+	void* memory = allocate(size, alignment, scope);
+	if (memory == nullptr) {
+		// The original must stay valid when the reallocation fails
+		return nullptr;
+	}
+	memcpy(memory, original, std::min(oldSize, size));
+	free(original);
+	return memory;
+}
+
+void HostAllocator::free(void* memory) {
+	if (memory == nullptr) {
+		return;
+	}
+	auto chunk = m_chunks.find(reinterpret_cast<uintptr_t>(memory) & ~(CHUNK_SIZE - 1));
+	if (chunk != m_chunks.end()) {
+		size_t index = static_cast<size_t>(chunk->second.scope);
+		void*& freeList = m_arenas[index].freeLists[chunk->second.sizeClass];
+		*static_cast<void**>(memory) = freeList;
+		freeList = memory;
+		m_stats.liveBytes[index] -= sizeClassBytes(chunk->second.sizeClass);
+		return;
+	}
+	auto large = m_largeAllocations.find(memory);
+	if (large == m_largeAllocations.end()) {
+		return;
+	}
+	m_stats.liveBytes[static_cast<size_t>(large->second.scope)] -= large->second.size;
+	::operator delete(memory, std::align_val_t(large->second.alignment));
+	m_largeAllocations.erase(large);
+}
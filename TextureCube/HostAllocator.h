@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// How long the driver keeps a host allocation, from the scope it asks with
+enum class HostScope : uint32_t {
+	// Only during a command (VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+	Command,
+	// As long as a Vulkan object or a cache (OBJECT and CACHE)
+	Object,
+	// As long as the device or the instance (DEVICE and INSTANCE)
+	Device,
+	Count
+};
+
+constexpr size_t HOST_SCOPE_COUNT = static_cast<size_t>(HostScope::Count);
+// Blocks of 16, 32, ... 4096 bytes. Anything bigger gets its own allocation
+constexpr size_t HOST_SIZE_CLASS_COUNT = 9;
+constexpr size_t HOST_LARGE_CLASS = HOST_SIZE_CLASS_COUNT;
+
+const char* hostScopeName(HostScope scope);
+
+struct HostAllocationStats {
+	// Per scope counters
+	std::array<uint64_t, HOST_SCOPE_COUNT> allocations{};
+	std::array<uint64_t, HOST_SCOPE_COUNT> reallocations{};
+	std::array<uint64_t, HOST_SCOPE_COUNT> liveBytes{};
+	std::array<uint64_t, HOST_SCOPE_COUNT> peakBytes{};
+	// Allocations of every scope by size class, the last one counts the large ones
+	std::array<std::array<uint64_t, HOST_SIZE_CLASS_COUNT + 1>, HOST_SCOPE_COUNT> sizeClasses{};
+	// What the driver allocated by itself and only told us about
+	std::array<uint64_t, HOST_SCOPE_COUNT> internalBytes{};
+	// Memory taken from the system for the blocks
+	uint64_t chunkBytes{ 0 };
+};
+
+//! Host memory for the driver, from arenas of fixed size blocks
+/*!
+  Every Vulkan call that creates or destroys something can take a
+  VkAllocationCallbacks, and the driver then asks it for its host memory
+  instead of the general purpose heap. This class gives the driver a separate
+  arena per \enum HostScope, so the short lived allocations of a command never
+  fragment the ones that live with the device. An arena keeps a free list per
+  size class, filled from 64 KiB chunks, so most allocations are a pop and
+  most frees a push. Big allocations go straight to the system.
+  The arenas never give their chunks back until the allocator is destroyed,
+  which must happen after the instance (and everything else) is destroyed.
+  It also counts every allocation by scope and size class.
+*/
+class HostAllocator {
+public:
+	HostAllocator();
+	~HostAllocator();
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+	//! The callbacks to give to the vkCreate and vkDestroy functions
+	const VkAllocationCallbacks* callbacks() const;
+	//! A copy of the counters
+	HostAllocationStats stats();
+	//! Bytes of the blocks of a size class
+	static size_t sizeClassBytes(size_t sizeClass);
+
+protected:
+	static VKAPI_ATTR void* VKAPI_CALL allocationCallback(void* userData, size_t size,
+		size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void* VKAPI_CALL reallocationCallback(void* userData, void* original,
+		size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL freeCallback(void* userData, void* memory);
+	static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(void* userData, size_t size,
+		VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(void* userData, size_t size,
+		VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static HostScope toHostScope(VkSystemAllocationScope scope);
+	//! These expect the mutex to be locked
+	void* allocate(size_t size, size_t alignment, HostScope scope);
+	void* reallocate(void* original, size_t size, size_t alignment, HostScope scope);
+	void free(void* memory);
+	//! Where a block of a size class came from
+	struct Chunk {
+		HostScope scope;
+		size_t sizeClass;
+	};
+	//! An allocation too big for the size classes
+	struct LargeAllocation {
+		HostScope scope;
+		size_t size;
+		size_t alignment;
+	};
+	//! Free blocks of every size class of a scope. Free blocks store the next one
+	struct Arena {
+		std::array<void*, HOST_SIZE_CLASS_COUNT> freeLists{};
+	};
+	VkAllocationCallbacks m_callbacks{};
+	std::array<Arena, HOST_SCOPE_COUNT> m_arenas;
+	//! Chunks by their address, which is aligned to their size
+	std::unordered_map<uintptr_t, Chunk> m_chunks;
+	std::unordered_map<void*, LargeAllocation> m_largeAllocations;
+	HostAllocationStats m_stats;
+	//! The driver can call us from any thread that calls it
+	std::mutex m_mutex;
+};
@@ -0,0 +1,78 @@
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Vertex.h"
+#include "TextureCubeApp.h"
+
+void TextureCubeApp::generateInstances(uint32_t count) {
+	TRACE_FUNCTION();
+	mInstances.clear();
+	mInstances.reserve(count);
+	mInstanceBounds.clear();
+	mInstanceBounds.reserve(count);
+	// Smallest cubic grid that holds them all, it takes the space of the
+	// original cube so a single instance looks exactly as before
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+	while (side * side * side < count) {
+		side++;
+	}
+	float cell = 1.0f / side;
+	float scale = side == 1 ? 1.0f : 0.7f * cell;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t x = i % side;
+		uint32_t y = (i / side) % side;
+		uint32_t z = i / (side * side);
+		glm::vec3 center = glm::vec3(-0.5f) + cell * (glm::vec3(x, y, z) + 0.5f);
+
+		InstanceData instance{};
+		instance.model = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(scale));
+		instance.materialId = (x + y + z) % MATERIAL_COUNT;
+		mInstances.push_back(instance);
+		// The sphere around the unit cube has a radius of half its diagonal
+		mInstanceBounds.push_back(glm::vec4(center, scale * 0.5f * std::sqrt(3.0f)));
+	}
+	mCuller.setSpheres(mInstanceBounds);
+}
+
+void TextureCubeApp::createInstanceBuffer() {
+	TRACE_FUNCTION();
+	VkDeviceSize bufferSize = sizeof(mInstances[0]) * mInstances.size();
+
+	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mInstanceBuffer, mInstanceBufferMemory,
+		MemoryCategory::Mesh);
+	// The bounding spheres are what the culling compute shader tests
+	VkDeviceSize boundsSize = sizeof(mInstanceBounds[0]) * mInstanceBounds.size();
+	createBuffer(boundsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mBoundsBuffer, mBoundsBufferMemory,
+		MemoryCategory::Mesh);
+	// Same as the vertices, through the transfer queue
+	UploadBatch upload = beginUpload();
+	uploadBuffer(upload, mInstances.data(), bufferSize, mInstanceBuffer,
+		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	uploadBuffer(upload, mInstanceBounds.data(), boundsSize, mBoundsBuffer,
+		VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	submitUpload(upload);
+}
+
+void TextureCubeApp::destroyInstanceBuffer() {
+	vkDestroyBuffer(mDevice, mBoundsBuffer, mHostCallbacks);
+	freeMemory(mBoundsBufferMemory);
+	vkDestroyBuffer(mDevice, mInstanceBuffer, mHostCallbacks);
+	freeMemory(mInstanceBufferMemory);
+}
+
+void TextureCubeApp::resizeInstances(uint32_t count) {
+	// Nothing in flight may still use the old buffers
+	vkDeviceWaitIdle(mDevice);
+	if (mGpuCulling) {
+		destroyCullingResources();
+	}
+	destroyInstanceBuffer();
+	generateInstances(count);
+	createInstanceBuffer();
+	if (mGpuCulling) {
+		createCullingResources();
+	}
+}
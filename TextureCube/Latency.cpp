@@ -0,0 +1,66 @@
+#include <iomanip>
+#include <iostream>
+
+#include "TextureCubeApp.h"
+
+void TextureCubeApp::pollQueuedFrame() {
+	// Without blocking, so the frame is timed when it completes and not when the
+	// next one gets around to waiting for it
+	if (!mPendingPresent.pending || mPendingPresent.completed) {
+		return;
+	}
+	// Only tagged when the headers (and the device) have present wait
+	if (mPendingPresent.presentId != 0) {
+#ifdef VK_KHR_present_wait
+		mPendingPresent.completed = mWaitForPresent(mDevice, mSwapChain,
+			mPendingPresent.presentId, 0) == VK_SUCCESS;
+#endif
+	} else {
+		uint64_t completedValue = 0;
+		vkGetSemaphoreCounterValue(mDevice, mFrameTimeline, &completedValue);
+		mPendingPresent.completed = completedValue >= mPendingPresent.timelineValue;
+	}
+	if (mPendingPresent.completed) {
+		mPendingPresent.completionTime = std::chrono::steady_clock::now();
+	}
+}
+
+void TextureCubeApp::waitForQueuedFrame() {
+	if (!mPendingPresent.pending) {
+		return;
+	}
+	mPendingPresent.pending = false;
+	TRACE_SCOPE("wait for present");
+	// Without present wait, the GPU being done is as close as we can tell
+	const char* until = mPendingPresent.presentId != 0 ? "present" : "gpu done";
+	if (!mPendingPresent.completed) {
+		if (mPendingPresent.presentId != 0) {
+#ifdef VK_KHR_present_wait
+			// Returns once the image is on the screen, or replaced by a newer one
+			VkResult result = mWaitForPresent(mDevice, mSwapChain, mPendingPresent.presentId,
+				PRESENT_WAIT_TIMEOUT);
+			if (result != VK_SUCCESS) {
+				// Timed out or out of date, no sample for this one
+				return;
+			}
+#endif
+		} else {
+			waitFrameTimeline(mPendingPresent.timelineValue);
+		}
+		// It was still queued, so it completed just now
+		mPendingPresent.completionTime = std::chrono::steady_clock::now();
+	}
+	double ms = std::chrono::duration<double, std::milli>(
+		mPendingPresent.completionTime - mPendingPresent.inputTime).count();
+	std::cout << std::fixed << std::setprecision(2) << "[latency] frame "
+		<< mPendingPresent.frameNumber << " input to " << until << " " << ms << " ms"
+		<< std::defaultfloat << std::endl;
+}
+
+void TextureCubeApp::sampleInput() {
+	// The trackball moves in the GLFW callbacks, so whatever came in while we
+	// waited for the image goes into this frame
+	TRACE_SCOPE("sample input");
+	pollEvents();
+	mInputTime = std::chrono::steady_clock::now();
+}
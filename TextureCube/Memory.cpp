@@ -0,0 +1,210 @@
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "Memory.h"
+#include "TextureCubeApp.h"
+
+static double toMiB(VkDeviceSize bytes) {
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+const char* memoryCategoryName(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::Texture:
+		return "textures";
+	case MemoryCategory::Mesh:
+		return "meshes";
+	case MemoryCategory::Attachment:
+		return "attachments";
+	case MemoryCategory::Staging:
+		return "staging";
+	case MemoryCategory::Uniform:
+		return "uniforms";
+	default:
+		return "unknown";
+	}
+}
+
+void TextureCubeApp::initMemoryTracking() {
+	TRACE_FUNCTION();
+	// The memory layout of the device never changes, so ask only once
+	vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &mMemProperties);
+
+	mMemoryStats = MemoryStats{};
+	mMemoryStats.heapTracked.resize(mMemProperties.memoryHeapCount, 0);
+	mMemoryStats.heapUsage.resize(mMemProperties.memoryHeapCount, 0);
+	mMemoryStats.heapBudget.resize(mMemProperties.memoryHeapCount, 0);
+	updateMemoryBudget();
+	mLastMemoryLog = std::chrono::steady_clock::now();
+}
+
+void TextureCubeApp::updateMemoryBudget() {
+	if (mMemoryBudgetSupported) {
+		// The driver tells us what the whole process uses and what we are allowed to
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memProperties{};
+		memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memProperties.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(mPhysicalDevice, &memProperties);
+
+		for (uint32_t i = 0; i < mMemProperties.memoryHeapCount; i++) {
+			mMemoryStats.heapUsage[i] = budgetProperties.heapUsage[i];
+			mMemoryStats.heapBudget[i] = budgetProperties.heapBudget[i];
+		}
+	} else {
+		// Without the extension we only know what we allocated ourselves,
+		// so leave some room for everybody else sharing the heap
+		for (uint32_t i = 0; i < mMemProperties.memoryHeapCount; i++) {
+			mMemoryStats.heapUsage[i] = mMemoryStats.heapTracked[i];
+			mMemoryStats.heapBudget[i] = mMemProperties.memoryHeaps[i].size / 10 * 8;
+		}
+	}
+}
+
+uint32_t TextureCubeApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+
+	std::optional<uint32_t> memoryType = findOptionalMemoryType(typeFilter, properties);
+	if (memoryType.has_value()) {
+		return memoryType.value();
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+std::optional<uint32_t> TextureCubeApp::findOptionalMemoryType(uint32_t typeFilter,
+	VkMemoryPropertyFlags properties) {
+
+	for (uint32_t i = 0; i < mMemProperties.memoryTypeCount; i++) {
+		if (  typeFilter & (1 << i) &&
+			  (mMemProperties.memoryTypes[i].propertyFlags & properties) == properties
+		   ) {
+			return i;
+		}
+	}
+
+	return std::nullopt;
+}
+
+bool TextureCubeApp::fitsMemoryBudget(uint32_t memoryType, VkDeviceSize size) {
+	uint32_t heap = mMemProperties.memoryTypes[memoryType].heapIndex;
+	return mMemoryStats.heapUsage[heap] + size <= mMemoryStats.heapBudget[heap];
+}
+
+VkDeviceMemory TextureCubeApp::allocateMemory(const VkMemoryRequirements& requirements,
+	VkMemoryPropertyFlags properties, MemoryCategory category) {
+
+	updateMemoryBudget();
+	uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	if (!fitsMemoryBudget(memoryType, requirements.size)) {
+		// Textures and meshes still work from system memory (only slower), so
+		// try any other heap before giving up. Everything else is refused
+		std::optional<uint32_t> fallback;
+		if ((category == MemoryCategory::Texture || category == MemoryCategory::Mesh) &&
+			(properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+			uint32_t fullHeap = mMemProperties.memoryTypes[memoryType].heapIndex;
+			uint32_t typeFilter = requirements.memoryTypeBits;
+			for (uint32_t i = 0; i < mMemProperties.memoryTypeCount; i++) {
+				if (mMemProperties.memoryTypes[i].heapIndex == fullHeap) {
+					typeFilter &= ~(1u << i);
+				}
+			}
+			fallback = findOptionalMemoryType(typeFilter,
+				properties & ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		if (!fallback.has_value() || !fitsMemoryBudget(fallback.value(), requirements.size)) {
+			mMemoryStats.refusals++;
+			throw std::runtime_error(std::string("memory budget exceeded allocating ") +
+				memoryCategoryName(category) + "!");
+		}
+		memoryType = fallback.value();
+		mMemoryStats.downgrades++;
+	}
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = memoryType;
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(mDevice, &allocInfo, mHostCallbacks, &memory) != VK_SUCCESS) {
+		throw std::runtime_error(std::string("failed to allocate memory for ") +
+			memoryCategoryName(category) + "!");
+	}
+	// Register it on the counters
+	MemoryAllocation allocation{ requirements.size, memoryType,
+		mMemProperties.memoryTypes[memoryType].heapIndex, category };
+	mAllocations[memory] = allocation;
+	size_t index = static_cast<size_t>(category);
+	mMemoryStats.bytes[index] += allocation.size;
+	mMemoryStats.allocations[index]++;
+	mMemoryStats.heapTracked[allocation.heap] += allocation.size;
+
+	return memory;
+}
+
+void TextureCubeApp::freeMemory(VkDeviceMemory memory) {
+	auto it = mAllocations.find(memory);
+	if (it != mAllocations.end()) {
+		const MemoryAllocation& allocation = it->second;
+		size_t index = static_cast<size_t>(allocation.category);
+		mMemoryStats.bytes[index] -= allocation.size;
+		mMemoryStats.allocations[index]--;
+		mMemoryStats.heapTracked[allocation.heap] -= allocation.size;
+		mAllocations.erase(it);
+	}
+	vkFreeMemory(mDevice, memory, mHostCallbacks);
+}
+
+MemoryStats TextureCubeApp::getMemoryStats() {
+	updateMemoryBudget();
+	return mMemoryStats;
+}
+
+void TextureCubeApp::logMemoryStats() {
+	MemoryStats stats = getMemoryStats();
+
+	std::cout << std::fixed << std::setprecision(1) << "[memory]";
+	for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		std::cout << " " << memoryCategoryName(static_cast<MemoryCategory>(i)) << " "
+			<< toMiB(stats.bytes[i]) << " MiB (" << stats.allocations[i] << ")";
+	}
+	for (size_t i = 0; i < stats.heapBudget.size(); i++) {
+		std::cout << " | heap" << i << " " << toMiB(stats.heapUsage[i]) << "/"
+			<< toMiB(stats.heapBudget[i]) << " MiB";
+	}
+	std::cout << " | downgraded " << stats.downgrades << ", refused " << stats.refusals
+		<< std::defaultfloat << std::endl;
+}
+
+void TextureCubeApp::logHostAllocationStats() {
+	if (mHostCallbacks == nullptr) {
+		return;
+	}
+	HostAllocationStats stats = mHostAllocator.stats();
+
+	std::cout << std::fixed << std::setprecision(2) << "[host]";
+	uint64_t internalBytes = 0;
+	for (size_t i = 0; i < HOST_SCOPE_COUNT; i++) {
+		std::cout << " " << hostScopeName(static_cast<HostScope>(i)) << " "
+			<< toMiB(stats.liveBytes[i]) << "/" << toMiB(stats.peakBytes[i]) << " MiB ("
+			<< stats.allocations[i] << ", " << stats.reallocations[i] << " realloc)";
+		internalBytes += stats.internalBytes[i];
+	}
+	std::cout << " | chunks " << toMiB(stats.chunkBytes) << " MiB, internal "
+		<< toMiB(internalBytes) << " MiB | sizes";
+	// Every scope together, to see which classes the driver really uses
+	for (size_t sizeClass = 0; sizeClass <= HOST_LARGE_CLASS; sizeClass++) {
+		uint64_t count = 0;
+		for (size_t i = 0; i < HOST_SCOPE_COUNT; i++) {
+			count += stats.sizeClasses[i][sizeClass];
+		}
+		if (sizeClass == HOST_LARGE_CLASS) {
+			std::cout << " large:" << count;
+		} else {
+			std::cout << " " << HostAllocator::sizeClassBytes(sizeClass) << ":" << count;
+		}
+	}
+	std::cout << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// What a device allocation is used for, so we know where our memory goes
+enum class MemoryCategory : uint32_t {
+	Texture,
+	Mesh,
+	Attachment,
+	Staging,
+	Uniform,
+	Count
+};
+
+constexpr size_t MEMORY_CATEGORY_COUNT = static_cast<size_t>(MemoryCategory::Count);
+
+const char* memoryCategoryName(MemoryCategory category);
+
+// Book keeping of a single vkAllocateMemory
+struct MemoryAllocation {
+	VkDeviceSize size;
+	uint32_t memoryType;
+	uint32_t heap;
+	MemoryCategory category;
+};
+
+struct MemoryStats {
+	// Per category counters
+	std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> bytes{};
+	std::array<uint32_t, MEMORY_CATEGORY_COUNT> allocations{};
+	// Allocations that did not fit their heap and went somewhere else
+	uint32_t downgrades{ 0 };
+	// Allocations we refused because they would not fit any heap
+	uint32_t refusals{ 0 };
+	// Per heap: what we allocated ourselves, what the whole process uses
+	// (VK_EXT_memory_budget, or our own count without it) and how much we can use
+	std::vector<VkDeviceSize> heapTracked;
+	std::vector<VkDeviceSize> heapUsage;
+	std::vector<VkDeviceSize> heapBudget;
+};
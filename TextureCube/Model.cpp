@@ -8,19 +8,24 @@
 #include "TextureCubeApp.h"
 
 void TextureCubeApp::loadModel() {
+	TRACE_FUNCTION();
 	// loadModelFromFile();
 	loadTextureCube();
 }
 
 void TextureCubeApp::loadModelFromFile(const std::string fileName) {
+	TRACE_FUNCTION();
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 	std::string warn, err;
 	std::string model_path = fileName.empty() ? MODEL_PATH : fileName;
 	// Load mesh from file
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path.c_str())) {
-		throw std::runtime_error(warn + err);
+	{
+		TRACE_SCOPE("parse obj");
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path.c_str())) {
+			throw std::runtime_error(warn + err);
+		}
 	}
 	// Lookup table to register vertex's index (and hence remove duplicates)
 	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "Options.h"
+
+// Reads the value that follows an option, like the 4 in "--threads 4"
+static uint32_t readUnsigned(int argc, char* argv[], int& i) {
+	std::string option = argv[i];
+	if (i + 1 >= argc) {
+		throw std::runtime_error("missing value for " + option + "!");
+	}
+	try {
+		size_t used = 0;
+		unsigned long value = std::stoul(argv[++i], &used);
+		if (argv[i][used] != '\0') {
+			throw std::invalid_argument(option);
+		}
+		return static_cast<uint32_t>(value);
+	} catch (const std::logic_error&) {
+		throw std::runtime_error("invalid value for " + option + "!");
+	}
+}
+
+// Same for a value that may have decimals, like the 8.3 in "--dynamic-resolution 8.3"
+static float readFloat(int argc, char* argv[], int& i) {
+	std::string option = argv[i];
+	if (i + 1 >= argc) {
+		throw std::runtime_error("missing value for " + option + "!");
+	}
+	try {
+		size_t used = 0;
+		float value = std::stof(argv[++i], &used);
+		if (argv[i][used] != '\0' || value < 0.0f) {
+			throw std::invalid_argument(option);
+		}
+		return value;
+	} catch (const std::logic_error&) {
+		throw std::runtime_error("invalid value for " + option + "!");
+	}
+}
+
+AppOptions parseOptions(int argc, char* argv[]) {
+	AppOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads") {
+			options.recordThreads = readUnsigned(argc, argv, i);
+		} else if (arg == "--instances") {
+			options.instanceCount = readUnsigned(argc, argv, i);
+			if (options.instanceCount == 0) {
+				throw std::runtime_error("--instances needs at least one instance!");
+			}
+		} else if (arg == "--no-instancing") {
+			options.instancing = false;
+		} else if (arg == "--cpu-culling") {
+			options.cpuCulling = true;
+		} else if (arg == "--gpu-culling") {
+			options.gpuCulling = true;
+		} else if (arg == "--verify-culling") {
+			options.verifyCulling = true;
+		} else if (arg == "--verify-geometry-pool") {
+			options.verifyGeometryPool = true;
+		} else if (arg == "--headless") {
+			options.headless = true;
+		} else if (arg == "--frames") {
+			options.frameCount = readUnsigned(argc, argv, i);
+		} else if (arg == "--frames-in-flight") {
+			options.framesInFlight = readUnsigned(argc, argv, i);
+			if (options.framesInFlight == 0 || options.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+				throw std::runtime_error("--frames-in-flight goes from 1 to "
+					+ std::to_string(MAX_FRAMES_IN_FLIGHT) + "!");
+			}
+		} else if (arg == "--low-latency") {
+			options.lowLatency = true;
+		} else if (arg == "--dynamic-resolution") {
+			options.targetGpuMs = readFloat(argc, argv, i);
+		} else if (arg == "--no-host-allocator") {
+			options.hostAllocator = false;
+		} else if (arg == "--no-pipeline-cache") {
+			options.pipelineCache = false;
+		} else if (arg == "--pipeline-cache-flush") {
+			options.pipelineCacheFlushPeriod = readUnsigned(argc, argv, i);
+		} else if (arg == "--trace") {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("missing value for " + arg + "!");
+			}
+			options.tracePath = argv[++i];
+		} else if (arg == "--benchmark-recording") {
+			options.benchmarkRecording = true;
+		} else if (arg == "--benchmark-instancing") {
+			options.benchmarkInstancing = true;
+		} else if (arg == "--benchmark-resize") {
+			options.benchmarkResize = true;
+		} else if (arg == "--benchmark-frames") {
+			options.benchmarkFrames = true;
+		} else if (arg == "--benchmark-output") {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("missing value for " + arg + "!");
+			}
+			options.benchmarkOutput = argv[++i];
+		} else if (arg == "--benchmark-culling") {
+			options.benchmarkCulling = true;
+		} else {
+			throw std::runtime_error("unknown option " + arg + "!");
+		}
+	}
+	if (options.headless && options.benchmarkResize) {
+		throw std::runtime_error("--benchmark-resize needs a window!");
+	}
+	if (options.headless && options.lowLatency) {
+		throw std::runtime_error("--low-latency needs a window!");
+	}
+	return options;
+}
+
+void printUsage(const std::string& program) {
+	std::cerr << "usage: " << program << " [options]\n"
+		<< "  --threads <n>            threads used to record the draws (0 = all)\n"
+		<< "  --instances <n>          copies of the mesh in the scene (default 1)\n"
+		<< "  --no-instancing          one draw per copy instead of one instanced draw\n"
+		<< "  --cpu-culling            cull on the cpu (simd) and draw the visible ones\n"
+		<< "  --gpu-culling            cull in a compute shader and draw indirectly\n"
+		<< "  --verify-culling         check the gpu visible count against the cpu\n"
+		<< "  --verify-geometry-pool   remove and compact meshes, check what the gpu holds\n"
+		<< "  --headless               render offscreen, no window (any device, even lavapipe)\n"
+		<< "  --frames <n>             frames to render before exiting (headless default 300)\n"
+		<< "  --frames-in-flight <n>   frames recorded ahead of the gpu, 1 to 4 (default 2)\n"
+		<< "  --low-latency            one frame queued at most, logs input to present times\n"
+		<< "  --dynamic-resolution <ms> scale the render resolution (50 to 100%) to keep\n"
+		<< "                           the gpu frame time under ms (0 = full resolution)\n"
+		<< "  --no-host-allocator      let the driver use its own heap for host memory\n"
+		<< "  --no-pipeline-cache      do not load or save the pipeline cache (cold start)\n"
+		<< "  --pipeline-cache-flush <s> also save the pipeline cache every s seconds\n"
+		<< "  --trace <file>           write a chrome trace of the cpu work on exit\n"
+		<< "  --benchmark-recording    measure the draw recording for 1..n threads\n"
+		<< "  --benchmark-instancing   measure the frame time for 1k..1M instances\n"
+		<< "  --benchmark-resize       measure the swapchain recreation while resizing\n"
+		<< "  --benchmark-frames       render a scripted camera path (--frames, default 600)\n"
+		<< "                           with a fixed time step and report the frame times\n"
+		<< "  --benchmark-output <file> json file of --benchmark-frames (default benchmark.json)\n"
+		<< "  --benchmark-culling      measure the cpu culling of 1M spheres and boxes\n";
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// What the user asked for in the command line
+struct AppOptions {
+	// Threads used to record the draws (0 means one per hardware thread)
+	uint32_t recordThreads{ 0 };
+	// Copies of the mesh in the scene
+	uint32_t instanceCount{ 1 };
+	// One instanced draw for all the copies, or one draw per copy
+	bool instancing{ true };
+	// Cull the instances on the CPU and draw only the visible ones
+	bool cpuCulling{ false };
+	// Cull the instances in a compute pass that writes the draws of the visible ones
+	bool gpuCulling{ false };
+	// Render offscreen, without a window or a surface (no GLFW at all)
+	bool headless{ false };
+	// Frames to render before exiting, 0 means until the window is closed
+	uint32_t frameCount{ 0 };
+	// Frames the CPU may record ahead of the GPU, more of them is more latency
+	// but less time waiting on either side (1 to MAX_FRAMES_IN_FLIGHT)
+	uint32_t framesInFlight{ 2 };
+	// Keep at most one frame queued for the display, sample the input right before
+	// recording and log how long it takes to reach the screen
+	bool lowLatency{ false };
+	// GPU time per frame the dynamic resolution aims for, in milliseconds. The scene
+	// renders smaller and is scaled up while it takes longer (0 = full resolution)
+	float targetGpuMs{ 0.0f };
+	// Give the driver our arenas for its host memory, instead of its own heap
+	bool hostAllocator{ true };
+	// Load the pipeline cache from disk at startup and save it back at shutdown
+	bool pipelineCache{ true };
+	// Seconds between two saves of the pipeline cache while running (0 = only at exit)
+	uint32_t pipelineCacheFlushPeriod{ 0 };
+	// Chrome trace of the CPU scopes written at exit (empty = no trace)
+	std::string tracePath;
+	// Run the command recording benchmark instead of the viewer
+	bool benchmarkRecording{ false };
+	// Run the frame time versus instance count benchmark
+	bool benchmarkInstancing{ false };
+	// Run the swapchain recreation benchmark (resizes the window every frame)
+	bool benchmarkResize{ false };
+	// Render a scripted camera path with a fixed time step and report the frame times
+	bool benchmarkFrames{ false };
+	// Where the frame benchmark writes its results
+	std::string benchmarkOutput{ "benchmark.json" };
+	// Run the CPU culling microbenchmark (no window, no device)
+	bool benchmarkCulling{ false };
+	// Compare the count of the GPU culling with the CPU (implies gpuCulling)
+	bool verifyCulling{ false };
+	// Remove and compact meshes of the geometry pool, then read it back and check it
+	bool verifyGeometryPool{ false };
+};
+
+// Upper bound of --frames-in-flight
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+AppOptions parseOptions(int argc, char* argv[]);
+void printUsage(const std::string& program);
@@ -1,51 +1,144 @@
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <iostream>
-#include <fstream>
+#include <sstream>
 
 #include "Vertex.h"
 #include "TextureCubeApp.h"
 
-static std::vector<char> readFile(const std::string& filename) {
-	// Open the file with cursor at the end
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open()) {
-		throw std::runtime_error("failed to open file!");
+// Features of every material, simple.frag has the same table for the pipelines
+// that are not specialized for one
+static ShadingConstants materialShading(uint32_t material) {
+	ShadingConstants shading{};
+	shading.material = static_cast<int32_t>(material);
+	switch (material) {
+	case 1:
+		// Matte, no highlights
+		shading.specularTexture = VK_FALSE;
+		break;
+	case 2:
+		// Glossy, sharper highlights
+		shading.shininess = 32.0f;
+		break;
+	case 3:
+		// Plain tint, no textures at all
+		shading.diffuseTexture = VK_FALSE;
+		shading.specularTexture = VK_FALSE;
+		break;
+	default:
+		break;
 	}
-	// Since cursor is at the and the size is
-	size_t fileSize = (size_t)file.tellg();
-	//std::cout << "file: " << filename << " size: " << fileSize << " bytes" << std::endl;
-
-	// Allocate buffer to hold the whole file
-	std::vector<char> buffer(fileSize);
-
-	file.seekg(0); // rewind cursor at the start of the file
-	file.read(buffer.data(), fileSize);
-	file.close();
+	return shading;
+}
 
-	return buffer;
+// FNV-1a of everything in the variant that changes the pipeline
+static uint64_t hashVariant(const PipelineVariant& variant) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	auto add = [&hash](const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	};
+	uint32_t sampleShading = variant.sampleShading ? 1 : 0;
+	add(&sampleShading, sizeof(sampleShading));
+	// Only 32 bit members, no padding to hash
+	add(&variant.shading, sizeof(variant.shading));
+	return hash;
 }
 
-VkShaderModule TextureCubeApp::createShaderModule(const std::vector<char>& byteCode) {
+VkShaderModule TextureCubeApp::createShaderModule(const std::vector<uint32_t>& byteCode) {
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	// The size is in bytes
-	createInfo.codeSize = byteCode.size();
-	// However the pointer is required as 32 bit codes
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(byteCode.data());
+	createInfo.codeSize = byteCode.size() * sizeof(uint32_t);
+	createInfo.pCode = byteCode.data();
 	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(mDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+	if (vkCreateShaderModule(mDevice, &createInfo, mHostCallbacks, &shaderModule) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create shader module!");
 	}
 	return shaderModule;
 }
 
+VkShaderModule TextureCubeApp::getShaderModule(const std::string& path, ShaderStage stage,
+	const std::vector<std::string>& defines) {
+
+	// The source is read every time, an edited file gets its own module
+	ShaderSource source = mShaderCompiler->load(path, stage, defines);
+	std::lock_guard<std::mutex> lock(mShaderModulesMutex);
+	auto it = mShaderModules.find(source.hash);
+	if (it != mShaderModules.end()) {
+		return it->second;
+	}
+	VkShaderModule shaderModule = createShaderModule(mShaderCompiler->compile(source));
+	mShaderModules[source.hash] = shaderModule;
+	return shaderModule;
+}
+
+void TextureCubeApp::destroyShaderModules() {
+	for (auto& shaderModule : mShaderModules) {
+		vkDestroyShaderModule(mDevice, shaderModule.second, mHostCallbacks);
+	}
+	mShaderModules.clear();
+}
 
 void TextureCubeApp::createGraphicsPipeline() {
-	auto vertShaderCode = readFile("shaders/vert.spv");
-	auto fragShaderCode = readFile("shaders/frag.spv");
-	// Create the vulkan objects
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+	TRACE_FUNCTION();
+	// Pipeline layout: Used to pass data to the pipeline (like uniforms)
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mDescriptorSetLayout;
+
+	if (vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, mHostCallbacks, &mPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+	// Something has to be on screen from the first frame, so the fallback is
+	// built right here. Everything else compiles in the background and the
+	// draws use the fallback until it is ready
+	mGraphicsPipeline = buildGraphicsPipeline({ "fallback", false, ShadingConstants{} });
+	mPipelineVariants.clear();
+	mPipelineIds.clear();
+	mPipelineTable.clear();
+	mScenePipeline = requestPipeline({ "scene", true, ShadingConstants{} });
+	mMaterialPipelines.resize(MATERIAL_COUNT);
+	for (uint32_t material = 0; material < MATERIAL_COUNT; material++) {
+		mMaterialPipelines[material] = requestPipeline({ "material " + std::to_string(material),
+			true, materialShading(material) });
+	}
+}
+
+uint32_t TextureCubeApp::requestPipeline(const PipelineVariant& variant) {
+	// Same permutation, same pipeline, the name does not count
+	uint64_t hash = hashVariant(variant);
+	auto it = mPipelineIds.find(hash);
+	if (it != mPipelineIds.end()) {
+		return it->second;
+	}
+	uint32_t id = static_cast<uint32_t>(mPipelineVariants.size());
+	mPipelineVariants.push_back(variant);
+	mPipelineIds[hash] = id;
+	mPipelineTable.push_back(mGraphicsPipeline);
+	mPipelineManager->request(id, [this, variant]() { return buildGraphicsPipeline(variant); });
+	return id;
+}
+
+void TextureCubeApp::resolvePipelines() {
+	// Once per frame, so the recording threads only read the table
+	for (uint32_t id = 0; id < mPipelineTable.size(); id++) {
+		VkPipeline pipeline = mPipelineManager->get(id);
+		mPipelineTable[id] = pipeline != VK_NULL_HANDLE ? pipeline : mGraphicsPipeline;
+	}
+}
+
+VkPipeline TextureCubeApp::buildGraphicsPipeline(const PipelineVariant& variant) {
+	TRACE_FUNCTION();
+	// Runs on the pipeline manager threads too, only touch what does not change
+	// Compiled (or taken from the cache) the first time, shared by every variant
+	VkShaderModule vertShaderModule = getShaderModule("shaders/simple.vert", ShaderStage::Vertex);
+	VkShaderModule fragShaderModule = getShaderModule("shaders/simple.frag", ShaderStage::Fragment);
 
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -53,25 +146,43 @@ void TextureCubeApp::createGraphicsPipeline() {
 	vertShaderStageInfo.module = vertShaderModule;
 	vertShaderStageInfo.pName = "main";
 
+	// The lighting and material paths of the variant, as specialization constants
+	const std::array<VkSpecializationMapEntry, 7> specializationEntries = { {
+		{ 0, offsetof(ShadingConstants, material), sizeof(int32_t) },
+		{ 1, offsetof(ShadingConstants, diffuseTexture), sizeof(VkBool32) },
+		{ 2, offsetof(ShadingConstants, specularTexture), sizeof(VkBool32) },
+		{ 3, offsetof(ShadingConstants, shininess), sizeof(float) },
+		{ 4, offsetof(ShadingConstants, lightX), sizeof(float) },
+		{ 5, offsetof(ShadingConstants, lightY), sizeof(float) },
+		{ 6, offsetof(ShadingConstants, lightZ), sizeof(float) }
+	} };
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(ShadingConstants);
+	specializationInfo.pData = &variant.shading;
+
 	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
 	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	fragShaderStageInfo.module = fragShaderModule;
 	fragShaderStageInfo.pName = "main";
+	fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 	// Store the infos in an array 
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 	// Fixed stage: Vertex input
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	// Get descriptors from class
-	auto bindingDescription = Vertex::getBindingDescription();
+	auto bindingDescriptions = Vertex::getBindingDescriptions();
 	auto attributeDescriptions = Vertex::getAttributeDescriptions();
 	// Use the descriptor to declare the vertex input
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexBindingDescriptionCount = 
+		static_cast<uint32_t>(bindingDescriptions.size());
 	vertexInputInfo.vertexAttributeDescriptionCount = 
 		static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	// Fixed state stage: Input assembbly
@@ -80,25 +191,14 @@ void TextureCubeApp::createGraphicsPipeline() {
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 	// Fixed state stage: Viewport Transformation
-	// First a viewport
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)mSwapChainExtent.width;
-	viewport.height = (float)mSwapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	// Second a sicssor buffer
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = mSwapChainExtent;
-	// Both of them are referenced in the viewport state
+	// The viewport and the scissor are dynamic (set when recording), so a
+	// resize does not need a new pipeline. Only their count goes here
 	VkPipelineViewportStateCreateInfo viewportState{};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
+	viewportState.pViewports = nullptr;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	viewportState.pScissors = nullptr;
 	// Fixed state stage: Rasterizer
 	VkPipelineRasterizationStateCreateInfo rasterizer{};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -115,8 +215,8 @@ void TextureCubeApp::createGraphicsPipeline() {
 	// Fixed state stage: Multisampling
 	VkPipelineMultisampleStateCreateInfo multisampling{};
 	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	// multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.sampleShadingEnable = VK_TRUE; // enable sample shading in the pipeline
+	// Sample shading runs the fragment shader per sample, the fallback skips it
+	multisampling.sampleShadingEnable = variant.sampleShading ? VK_TRUE : VK_FALSE;
 	multisampling.rasterizationSamples = mMsaaSamples;
 	// multisampling.minSampleShading = 1.0f; // Optional
 	multisampling.minSampleShading = .2f; // min fraction for sample shading; closer to one is smoother
@@ -154,18 +254,14 @@ void TextureCubeApp::createGraphicsPipeline() {
 	colorBlending.blendConstants[2] = 0.0f; // Optional
 	colorBlending.blendConstants[3] = 0.0f; // Optional
 	// Configure dynamic state portion of the pipleine
-	/*
-		We do not have it in this case. But if required, it will be here
-		VkDynamicState dynamicStates[] = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_LINE_WIDTH
-		};
-
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.dynamicStateCount = 2;
-		dynamicState.pDynamicStates = dynamicStates;
-	*/
+	VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
 	// Create the depth and stencil state
 	VkPipelineDepthStencilStateCreateInfo depthStencil{};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
@@ -182,15 +278,6 @@ void TextureCubeApp::createGraphicsPipeline() {
 	depthStencil.front = {}; // Optional
 	depthStencil.back = {}; // Optional
 
-	// Pipeline layout: Used to pass data to the pipeline (like uniforms)
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &mDescriptorSetLayout;
-
-	if (vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create pipeline layout!");
-	}
 	/* Finally ready to create the pipeline */
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -205,7 +292,7 @@ void TextureCubeApp::createGraphicsPipeline() {
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr; // Optional
+	pipelineInfo.pDynamicState = &dynamicState;
 	// Pipeline layout and render pass
 	pipelineInfo.layout = mPipelineLayout;
 	pipelineInfo.renderPass = mRenderPass;
@@ -214,18 +301,30 @@ void TextureCubeApp::createGraphicsPipeline() {
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 	pipelineInfo.basePipelineIndex = -1; // Optional
 
-	// Create the pipeline
-	if (vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo,
-		nullptr, &mGraphicsPipeline) != VK_SUCCESS) {
+	// Create the pipeline, the cache skips the compilation if it was done before
+	// (and it is safe to share between threads)
+	bool warm = mPipelineCacheWarm;
+	auto start = std::chrono::steady_clock::now();
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(mDevice, mPipelineCache, 1, &pipelineInfo,
+		mHostCallbacks, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
-
-	// Destroy the shader objects, since we already have the pipeline
-	vkDestroyShaderModule(mDevice, fragShaderModule, nullptr);
-	vkDestroyShaderModule(mDevice, vertShaderModule, nullptr);
+	auto end = std::chrono::steady_clock::now();
+	// In one piece, other threads may be logging too
+	std::ostringstream message;
+	message << "[pipeline] " << variant.name << " pipeline created in "
+		<< std::chrono::duration<double, std::milli>(end - start).count() << " ms ("
+		<< (warm ? "warm" : "cold") << " cache)\n";
+	std::cout << message.str() << std::flush;
+	// From now on the cache has it, like after a swapchain recreation
+	mPipelineCacheWarm = true;
+	// The shader modules stay, the next variants (or recreations) use them again
+	return pipeline;
 }
 
 void TextureCubeApp::createRenderPass() {
+	TRACE_FUNCTION();
 	// We have just one framebuffer (as a color attachment)
 	VkAttachmentDescription colorAttachment{};
 	colorAttachment.format = mSwapChainImageFormat;
@@ -261,7 +360,10 @@ void TextureCubeApp::createRenderPass() {
 	colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// Ready to present, or to be copied out when rendering offscreen. With the dynamic
+	// resolution it is the scene image, which the upscale copies from
+	colorAttachmentResolve.finalLayout = mHeadless || mDynamicResolution ?
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	// We need to create a subpass (for things like shadow map, might be more than one)
 	// Each subpass references one attachment
@@ -292,6 +394,10 @@ void TextureCubeApp::createRenderPass() {
 	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | 
 							  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 	dependency.srcAccessMask = 0;
+	if (mDynamicResolution) {
+		// The scene image is shared by the frames, the previous upscale must be done reading it
+		dependency.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
 
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | 
 							  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
@@ -312,7 +418,65 @@ void TextureCubeApp::createRenderPass() {
 
 	
 	// Create the render pass
-	if (vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mRenderPass) != VK_SUCCESS) {
+	if (vkCreateRenderPass(mDevice, &renderPassInfo, mHostCallbacks, &mRenderPass) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create render pass!");
 	}
 }
+
+void TextureCubeApp::createCullingPipeline() {
+	TRACE_FUNCTION();
+	// The bounds to test, the draws written for the visible ones and their count
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, mHostCallbacks, &mCullingSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor set layout!");
+	}
+	// The frustum changes every frame, it goes as push constants
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullingPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mCullingSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, mHostCallbacks, &mCullingPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling pipeline layout!");
+	}
+
+	VkShaderModule compShaderModule = getShaderModule("shaders/cull.comp", ShaderStage::Compute);
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = mCullingPipelineLayout;
+
+	if (vkCreateComputePipelines(mDevice, mPipelineCache, 1, &pipelineInfo,
+		mHostCallbacks, &mCullingPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling pipeline!");
+	}
+}
+
+void TextureCubeApp::destroyCullingPipeline() {
+	vkDestroyPipeline(mDevice, mCullingPipeline, mHostCallbacks);
+	vkDestroyPipelineLayout(mDevice, mCullingPipelineLayout, mHostCallbacks);
+	vkDestroyDescriptorSetLayout(mDevice, mCullingSetLayout, mHostCallbacks);
+}
@@ -0,0 +1,137 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "TextureCubeApp.h"
+
+// Header every VkPipelineCache blob starts with (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+struct PipelineCacheHeader {
+	uint32_t headerSize;
+	uint32_t headerVersion;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+// The data of a previous run, if it was written by this same device and driver
+static std::vector<char> readPipelineCache(const std::string& path,
+	const VkPhysicalDeviceProperties& properties) {
+
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return {};
+	}
+	std::vector<char> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(data.data(), data.size());
+	if (!file) {
+		std::cerr << "[pipeline] could not read " << path << ", starting cold" << std::endl;
+		return {};
+	}
+
+	// The driver should reject a foreign blob by itself, but not all of them do
+	// it gracefully, so check it is ours before handing it over
+	PipelineCacheHeader header{};
+	if (data.size() < sizeof(header)) {
+		std::cerr << "[pipeline] " << path << " is truncated, starting cold" << std::endl;
+		return {};
+	}
+	memcpy(&header, data.data(), sizeof(header));
+	if (header.headerSize < sizeof(header) || header.headerSize > data.size() ||
+		header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+		std::cerr << "[pipeline] " << path << " has a bad header, starting cold" << std::endl;
+		return {};
+	}
+	if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+		memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		// Other GPU or other driver version, it is useless to us
+		std::cerr << "[pipeline] " << path << " belongs to another device or driver, starting cold"
+			<< std::endl;
+		return {};
+	}
+	return data;
+}
+
+void TextureCubeApp::createPipelineCache() {
+	TRACE_FUNCTION();
+	std::vector<char> initialData;
+	if (mOptions.pipelineCache) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+		initialData = readPipelineCache(PIPELINE_CACHE_PATH, properties);
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = initialData.size();
+	cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+	if (vkCreatePipelineCache(mDevice, &cacheInfo, mHostCallbacks, &mPipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+	mPipelineCacheWarm = !initialData.empty();
+	mPipelineCacheSavedSize = initialData.size();
+	mLastPipelineCacheFlush = std::chrono::steady_clock::now();
+}
+
+void TextureCubeApp::savePipelineCache() {
+	if (!mOptions.pipelineCache) {
+		return;
+	}
+	size_t size = 0;
+	if (vkGetPipelineCacheData(mDevice, mPipelineCache, &size, nullptr) != VK_SUCCESS) {
+		std::cerr << "[pipeline] failed to query the pipeline cache size" << std::endl;
+		return;
+	}
+	if (size == mPipelineCacheSavedSize) {
+		// Nothing new was compiled since the last save
+		return;
+	}
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(mDevice, mPipelineCache, &size, data.data()) != VK_SUCCESS) {
+		std::cerr << "[pipeline] failed to get the pipeline cache data" << std::endl;
+		return;
+	}
+
+	// Write next to the old one and swap them, so a crash half way through
+	// never leaves a broken cache behind. Failing here is not fatal, the next
+	// run just starts cold
+	std::string temporaryPath = PIPELINE_CACHE_PATH + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), size);
+		file.close();
+		if (!file) {
+			std::cerr << "[pipeline] could not write " << temporaryPath << std::endl;
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, PIPELINE_CACHE_PATH, error);
+	if (error) {
+		std::cerr << "[pipeline] could not replace " << PIPELINE_CACHE_PATH << ": "
+			<< error.message() << std::endl;
+		std::filesystem::remove(temporaryPath, error);
+		return;
+	}
+	mPipelineCacheSavedSize = size;
+}
+
+void TextureCubeApp::flushPipelineCache() {
+	if (mOptions.pipelineCacheFlushPeriod == 0) {
+		return;
+	}
+	auto now = std::chrono::steady_clock::now();
+	if (std::chrono::duration<float>(now - mLastPipelineCacheFlush).count() >
+		static_cast<float>(mOptions.pipelineCacheFlushPeriod)) {
+		savePipelineCache();
+		mLastPipelineCacheFlush = now;
+	}
+}
+
+void TextureCubeApp::destroyPipelineCache() {
+	savePipelineCache();
+	vkDestroyPipelineCache(mDevice, mPipelineCache, mHostCallbacks);
+}
@@ -0,0 +1,44 @@
+#include <chrono>
+#include <stdexcept>
+
+#include "PipelineManager.h"
+
+PipelineManager::PipelineManager(size_t threadCount) : m_pool(threadCount) {
+}
+
+std::shared_future<VkPipeline> PipelineManager::request(uint32_t id,
+	std::function<VkPipeline()> build) {
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_pipelines.find(id);
+	if (it != m_pipelines.end()) {
+		return it->second;
+	}
+	std::shared_future<VkPipeline> pipeline = m_pool.submit(std::move(build)).share();
+	m_pipelines[id] = pipeline;
+	return pipeline;
+}
+
+VkPipeline PipelineManager::get(uint32_t id) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_pipelines.find(id);
+	if (it == m_pipelines.end() ||
+		it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return VK_NULL_HANDLE;
+	}
+	return it->second.get();
+}
+
+std::vector<VkPipeline> PipelineManager::release() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<VkPipeline> pipelines;
+	for (auto& pipeline : m_pipelines) {
+		// A failed build has nothing to destroy
+		try {
+			pipelines.push_back(pipeline.second.get());
+		} catch (const std::exception&) {
+		}
+	}
+	m_pipelines.clear();
+	return pipelines;
+}
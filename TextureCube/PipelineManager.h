@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "ThreadPool.h"
+//! Compiles pipelines on its own worker threads, so nobody waits for them
+/*!
+  A pipeline is requested once with the function that builds it, and the
+  build runs on one of the worker threads of the manager. Those threads are
+  not the ones recording the draws, so a slow compilation never holds a
+  frame back. Until a pipeline is ready \fn get returns VK_NULL_HANDLE and
+  the renderer draws with something cheaper (or skips the draw).
+*/
+class PipelineManager {
+public:
+	//! Creates the manager with the given number of compiling threads
+	explicit PipelineManager(size_t threadCount = 1);
+	PipelineManager(const PipelineManager&) = delete;
+	PipelineManager& operator=(const PipelineManager&) = delete;
+	//! Queues the build of a pipeline, unless the id was already requested
+	/*!
+	  The build function runs on a worker thread, so it can only touch what is
+	  safe to use from there. The future can be waited on by whoever really
+	  needs the pipeline, it rethrows if the build threw
+	*/
+	std::shared_future<VkPipeline> request(uint32_t id, std::function<VkPipeline()> build);
+	//! The pipeline if it is ready, VK_NULL_HANDLE if it is still compiling
+	/*!
+	  Never blocks. If the build failed, it rethrows its exception
+	*/
+	VkPipeline get(uint32_t id);
+	//! Waits for every build and returns the pipelines, which are forgotten
+	/*!
+	  The caller destroys them, for instance because the render pass changed
+	*/
+	std::vector<VkPipeline> release();
+
+protected:
+	//! Pipelines requested so far, ready or not
+	std::unordered_map<uint32_t, std::shared_future<VkPipeline>> m_pipelines;
+	//! Protects the map, requests and lookups may come from several threads
+	std::mutex m_mutex;
+	//! Where the builds run. Destroyed first, so it waits for the builds in flight
+	ThreadPool m_pool;
+};
@@ -4,12 +4,14 @@
 #include "TextureCubeApp.h"
 
 void TextureCubeApp::createSurface() {
-	if (glfwCreateWindowSurface(mInstance, mWindow, nullptr, &mSurface) != VK_SUCCESS) {
+	TRACE_FUNCTION();
+	if (glfwCreateWindowSurface(mInstance, mWindow, mHostCallbacks, &mSurface) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create window surface!");
 	}
 }
 
-void TextureCubeApp::recreateSwapChain() {
+void TextureCubeApp::recreateSwapChain(bool rebuildAll) {
+	TRACE_FUNCTION();
 
 	int width = 0, height = 0;
 	glfwGetFramebufferSize(mWindow, &width, &height);
@@ -20,64 +22,81 @@ void TextureCubeApp::recreateSwapChain() {
 
 	vkDeviceWaitIdle(mDevice);
 
+	VkFormat oldFormat = mSwapChainImageFormat;
+	// Its present went to the old swapchain, there is nothing left to wait for
+	mPendingPresent.pending = false;
 	cleanupSwapChain();
 
 	createSwapChain();
 	createImageViews();
-	createRenderPass();
-	createGraphicsPipeline();
-	createColorResources();
-	createDepthResources();
+	// The viewport and scissor are dynamic, so the render pass and the pipeline
+	// only depend on the formats and the sample count. The samples are picked
+	// with the device and never change, the surface format might
+	if (rebuildAll || mSwapChainImageFormat != oldFormat) {
+		destroyRenderPipeline();
+		createRenderPass();
+		createGraphicsPipeline();
+		mSwapChainStats.pipelineRebuilds++;
+	}
+	createTransientAttachments();
+	createSceneTarget();
 	createFramebuffers();
-	createUniformBuffers();
-	createDescriptorPool();
-	createDescriptorSets();
-	createCommandBuffers();
+	// Uniforms and sets go per frame in flight, the swapchain has nothing to do with them
+	mSwapChainStats.recreations++;
 }
 
 void TextureCubeApp::cleanupSwapChain() {
+	TRACE_FUNCTION();
+	// Only what depends on the size of the swapchain
+
+	vkDestroyImageView(mDevice, mColorImageView, mHostCallbacks);
+	vkDestroyImage(mDevice, mColorImage, mHostCallbacks);
 
-	vkDestroyImageView(mDevice, mColorImageView, nullptr);
-	vkDestroyImage(mDevice, mColorImage, nullptr);
-	vkFreeMemory(mDevice, mColorImageMemory, nullptr);
+	vkDestroyImageView(mDevice, mDepthImageView, mHostCallbacks);
+	vkDestroyImage(mDevice, mDepthImage, mHostCallbacks);
 
-	vkDestroyImageView(mDevice, mDepthImageView, nullptr);
-	vkDestroyImage(mDevice, mDepthImage, nullptr);
-	vkFreeMemory(mDevice, mDepthImageMemory, nullptr);
+	freeMemory(mTransientMemory);
+	destroySceneTarget();
 
 	for (size_t i = 0; i < mSwapChainFramebuffers.size(); i++) {
-		vkDestroyFramebuffer(mDevice, mSwapChainFramebuffers[i], nullptr);
+		vkDestroyFramebuffer(mDevice, mSwapChainFramebuffers[i], mHostCallbacks);
 	}
 
-	vkFreeCommandBuffers(mDevice, mCommandPool,
-		static_cast<uint32_t>(mCommandBuffers.size()), mCommandBuffers.data());
-
-	vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
-	vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
-
 	for (size_t i = 0; i < mSwapChainImageViews.size(); i++) {
-		vkDestroyImageView(mDevice, mSwapChainImageViews[i], nullptr);
+		vkDestroyImageView(mDevice, mSwapChainImageViews[i], mHostCallbacks);
 	}
 
-	vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
-
-	for (size_t i = 0; i < mSwapChainImages.size(); i++) {
-		vkDestroyBuffer(mDevice, mUniformBuffers[i], nullptr);
-		vkFreeMemory(mDevice, mUniformBuffersMemory[i], nullptr);
+	if (mHeadless) {
+		destroyOffscreenImages();
+	} else {
+		vkDestroySwapchainKHR(mDevice, mSwapChain, mHostCallbacks);
 	}
+}
 
-	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+void TextureCubeApp::destroyRenderPipeline() {
+	// Waits for the variants still compiling, they use the render pass
+	for (VkPipeline pipeline : mPipelineManager->release()) {
+		vkDestroyPipeline(mDevice, pipeline, mHostCallbacks);
+	}
+	vkDestroyPipeline(mDevice, mGraphicsPipeline, mHostCallbacks);
+	vkDestroyPipelineLayout(mDevice, mPipelineLayout, mHostCallbacks);
+	vkDestroyRenderPass(mDevice, mRenderPass, mHostCallbacks);
 }
 
 void TextureCubeApp::createSwapChain() {
+	TRACE_FUNCTION();
+	if (mHeadless) {
+		createOffscreenImages();
+		return;
+	}
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(mPhysicalDevice);
 	// We chose the best format, present mode and extent form all the available
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-	// Now we specify how many image we will require
-	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	// Now we specify how many image we will require. One more than the minimum
+	// lets us render ahead, the low latency mode does not want that
+	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + (mLowLatency ? 0 : 1);
 	// Make sur we do not exced the maximum
 	if (// zero is a special value that means no maxmimum
 		swapChainSupport.capabilities.maxImageCount > 0 &&
@@ -96,6 +115,10 @@ void TextureCubeApp::createSwapChain() {
 	createInfo.imageExtent = extent;
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	if (mDynamicResolution) {
+		// The upscale blits into it
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
 
 	// Keep a copy of the format and the extend since we will need it
 	mSwapChainImageFormat = surfaceFormat.format;
@@ -124,7 +147,7 @@ void TextureCubeApp::createSwapChain() {
 	// If I do not provide this two, the validation layer presents this
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 
-	if (vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapChain) != VK_SUCCESS) {
+	if (vkCreateSwapchainKHR(mDevice, &createInfo, mHostCallbacks, &mSwapChain) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create swap chain!");
 	}
 
@@ -134,6 +157,7 @@ void TextureCubeApp::createSwapChain() {
 }
 
 void TextureCubeApp::createImageViews() {
+	TRACE_FUNCTION();
 	// Rezise array to hold the number of required views
 	// (one per image)
 	mSwapChainImageViews.resize(mSwapChainImages.size());
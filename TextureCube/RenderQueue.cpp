@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <array>
+
+#include "RenderQueue.h"
+
+static const uint32_t DEPTH_BITS = 24;
+static const uint32_t MESH_BITS = 16;
+static const uint32_t MATERIAL_BITS = 16;
+static const uint32_t PIPELINE_BITS = 8;
+
+static const uint32_t MESH_SHIFT = DEPTH_BITS;
+static const uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+static const uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+
+static uint64_t field(uint32_t value, uint32_t bits, uint32_t shift) {
+	return (static_cast<uint64_t>(value) & ((1ull << bits) - 1)) << shift;
+}
+
+uint64_t RenderQueue::makeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+	// Out of range depths (behind the camera or past far) just go to the ends
+	float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+	uint32_t quantized = static_cast<uint32_t>(clamped * static_cast<float>((1u << DEPTH_BITS) - 1));
+	return field(pipeline, PIPELINE_BITS, PIPELINE_SHIFT) |
+		field(material, MATERIAL_BITS, MATERIAL_SHIFT) |
+		field(mesh, MESH_BITS, MESH_SHIFT) |
+		field(quantized, DEPTH_BITS, 0);
+}
+
+uint32_t RenderQueue::pipelineOf(uint64_t key) {
+	return static_cast<uint32_t>((key >> PIPELINE_SHIFT) & ((1ull << PIPELINE_BITS) - 1));
+}
+
+uint32_t RenderQueue::materialOf(uint64_t key) {
+	return static_cast<uint32_t>((key >> MATERIAL_SHIFT) & ((1ull << MATERIAL_BITS) - 1));
+}
+
+uint32_t RenderQueue::meshOf(uint64_t key) {
+	return static_cast<uint32_t>((key >> MESH_SHIFT) & ((1ull << MESH_BITS) - 1));
+}
+
+void RenderQueue::clear() {
+	m_items.clear();
+}
+
+void RenderQueue::reserve(size_t count) {
+	m_items.reserve(count);
+}
+
+void RenderQueue::push(uint64_t key, uint32_t instance) {
+	m_items.push_back({ key, instance });
+}
+
+void RenderQueue::sort() {
+	const uint32_t RADIX_BITS = 8;
+	const uint32_t PASSES = 64 / RADIX_BITS;
+	const uint32_t BUCKETS = 1u << RADIX_BITS;
+	size_t count = m_items.size();
+	if (count < 2) {
+		return;
+	}
+	// All the histograms in a single read of the keys
+	std::array<std::array<uint32_t, BUCKETS>, PASSES> histograms{};
+	for (const auto& item : m_items) {
+		for (uint32_t pass = 0; pass < PASSES; pass++) {
+			histograms[pass][(item.key >> (pass * RADIX_BITS)) & (BUCKETS - 1)]++;
+		}
+	}
+
+	m_scratch.resize(count);
+	for (uint32_t pass = 0; pass < PASSES; pass++) {
+		auto& histogram = histograms[pass];
+		// If every key has the same digit the pass would not move anything.
+		// With few pipelines, materials and meshes most of the high passes go away
+		uint32_t digit = (m_items[0].key >> (pass * RADIX_BITS)) & (BUCKETS - 1);
+		if (histogram[digit] == count) {
+			continue;
+		}
+		// Where each digit starts in the output
+		uint32_t offset = 0;
+		for (auto& bucket : histogram) {
+			uint32_t bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+		// Stable scatter, so the previous passes stay sorted
+		for (const auto& item : m_items) {
+			m_scratch[histogram[(item.key >> (pass * RADIX_BITS)) & (BUCKETS - 1)]++] = item;
+		}
+		m_items.swap(m_scratch);
+	}
+}
+
+uint32_t RenderQueue::size() const {
+	return static_cast<uint32_t>(m_items.size());
+}
+
+const std::vector<DrawItem>& RenderQueue::items() const {
+	return m_items;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+//! One draw waiting in a \class RenderQueue
+struct DrawItem {
+	//! Sort key, see \class RenderQueue for the layout
+	uint64_t key;
+	//! Instance to draw
+	uint32_t instance;
+};
+//! A list of draws sorted to minimize the state changes between them
+/*!
+  Every draw gets a 64 bit key with the state it needs, from the most
+  expensive to change to the cheapest:
+
+    | pipeline (8) | material (16) | mesh (16) | depth (24) |
+
+  so after sorting, the draws that share a pipeline are together, inside
+  them the ones that share a material, and so on. The depth goes last and
+  sorts front to back, to help the early depth test. Keys are sorted with
+  an LSD radix sort, that is linear in the number of draws.
+*/
+class RenderQueue {
+public:
+	//! Packs the state of a draw in a key, depth goes from 0 (near) to 1 (far)
+	static uint64_t makeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+	//! Pipeline of a key
+	static uint32_t pipelineOf(uint64_t key);
+	//! Material of a key
+	static uint32_t materialOf(uint64_t key);
+	//! Mesh of a key
+	static uint32_t meshOf(uint64_t key);
+	//! Removes all the draws (keeps the memory)
+	void clear();
+	//! Makes room for the given number of draws
+	void reserve(size_t count);
+	//! Adds a draw to the queue
+	void push(uint64_t key, uint32_t instance);
+	//! Sorts the draws by key, draws with equal keys keep their order
+	void sort();
+	//! Number of draws in the queue
+	uint32_t size() const;
+	//! The draws, sorted after calling sort()
+	const std::vector<DrawItem>& items() const;
+
+protected:
+	//! The draws
+	std::vector<DrawItem> m_items;
+	//! Where each radix pass writes, swapped with the items after the pass
+	std::vector<DrawItem> m_scratch;
+};
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "TextureCubeApp.h"
+
+void TextureCubeApp::initDynamicResolution() {
+	mDynamicResolution = mOptions.targetGpuMs > 0.0f;
+	if (!mDynamicResolution) {
+		return;
+	}
+	// The upscale is a linear blit into the swapchain image (the offscreen format
+	// when headless), the surface has to let us write there
+	VkFormat format = VK_FORMAT_B8G8R8A8_SRGB;
+	bool transferDst = true;
+	if (!mHeadless) {
+		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(mPhysicalDevice);
+		format = chooseSwapSurfaceFormat(swapChainSupport.formats).format;
+		transferDst = (swapChainSupport.capabilities.supportedUsageFlags &
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+	}
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, format, &properties);
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	if (!transferDst || (properties.optimalTilingFeatures & needed) != needed) {
+		std::cerr << "[resolution] can not blit to the swapchain images, rendering at full resolution"
+			<< std::endl;
+		mDynamicResolution = false;
+		return;
+	}
+	std::cout << "[resolution] scaling between " << static_cast<int>(MIN_RENDER_SCALE * 100.0f)
+		<< "% and " << static_cast<int>(MAX_RENDER_SCALE * 100.0f) << "% to keep the gpu under "
+		<< mOptions.targetGpuMs << " ms" << std::endl;
+}
+
+void TextureCubeApp::createSceneTarget() {
+	if (!mDynamicResolution) {
+		return;
+	}
+	// Resolve target of the render pass and source of the upscale. As big as the
+	// swapchain, the smaller scales only use part of it
+	createImage(mSwapChainExtent.width, mSwapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT,
+		mSwapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mSceneImage, mSceneImageMemory,
+		MemoryCategory::Attachment);
+	mSceneImageView = createImageView(mSceneImage, mSwapChainImageFormat,
+		VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void TextureCubeApp::destroySceneTarget() {
+	if (mSceneImage == VK_NULL_HANDLE) {
+		return;
+	}
+	vkDestroyImageView(mDevice, mSceneImageView, mHostCallbacks);
+	vkDestroyImage(mDevice, mSceneImage, mHostCallbacks);
+	freeMemory(mSceneImageMemory);
+	mSceneImageView = VK_NULL_HANDLE;
+	mSceneImage = VK_NULL_HANDLE;
+	mSceneImageMemory = VK_NULL_HANDLE;
+}
+
+VkExtent2D TextureCubeApp::scaledExtent(float scale) {
+	// Rounded, so the full scale is exactly the swapchain extent
+	VkExtent2D extent;
+	extent.width = std::max(static_cast<uint32_t>(std::lround(mSwapChainExtent.width * scale)), 1u);
+	extent.height = std::max(static_cast<uint32_t>(std::lround(mSwapChainExtent.height * scale)), 1u);
+	return extent;
+}
+
+void TextureCubeApp::recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+	VkExtent2D renderExtent) {
+
+	std::array<VkImageMemoryBarrier, 2> barriers{};
+	for (auto& barrier : barriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+	}
+	// The render pass left the resolve in the layout to copy from, wait for it
+	barriers[0].image = mSceneImage;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	// The blit covers the whole swapchain image, what it had can go. The acquire
+	// semaphore was waited at the color output stage, which this barrier waits for.
+	// Offscreen the image may still be the target of an older frame's blit
+	barriers[1].image = mSwapChainImages[imageIndex];
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	// Stretch the rendered part over the whole image
+	VkImageBlit blit{};
+	blit.srcOffsets[0] = { 0, 0, 0 };
+	blit.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width),
+		static_cast<int32_t>(renderExtent.height), 1 };
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.mipLevel = 0;
+	blit.srcSubresource.baseArrayLayer = 0;
+	blit.srcSubresource.layerCount = 1;
+	blit.dstOffsets[0] = { 0, 0, 0 };
+	blit.dstOffsets[1] = { static_cast<int32_t>(mSwapChainExtent.width),
+		static_cast<int32_t>(mSwapChainExtent.height), 1 };
+	blit.dstSubresource = blit.srcSubresource;
+	vkCmdBlitImage(commandBuffer, mSceneImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		mSwapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+		VK_FILTER_LINEAR);
+
+	// Same layout the render pass would leave it in: ready to present, or to be copied out
+	VkImageMemoryBarrier barrier = barriers[1];
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = mHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL :
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void TextureCubeApp::updateRenderScale(const FrameContext& frame) {
+	// Frames recorded before the last change tell nothing about the current scale
+	if (frame.gpuTimeMs < 0.0 || frame.renderScale != mRenderScale) {
+		return;
+	}
+	// A plain mean while settling, then a moving average
+	mScaleSamples++;
+	double weight = std::max(1.0 / mScaleSamples, GPU_TIME_SMOOTHING);
+	mScaleGpuTimeMs += weight * (frame.gpuTimeMs - mScaleGpuTimeMs);
+	if (mScaleSamples < SCALE_SETTLE_FRAMES) {
+		return;
+	}
+	// Inside the band the scale holds, so it does not go back and forth around the target
+	double target = mOptions.targetGpuMs;
+	bool tooSlow = mScaleGpuTimeMs > target;
+	bool tooFast = mScaleGpuTimeMs < SCALE_UP_THRESHOLD * target;
+	if (!tooSlow && !tooFast) {
+		return;
+	}
+	// The GPU time goes with the pixels, the square of the scale. Aim for the middle
+	// of the band, but only a few steps at a time: the time is not all pixels
+	double aim = target * (1.0 + SCALE_UP_THRESHOLD) / 2.0;
+	float scale = mRenderScale * static_cast<float>(std::sqrt(aim / std::max(mScaleGpuTimeMs, 1e-3)));
+	scale = std::clamp(scale, mRenderScale - MAX_RENDER_SCALE_CHANGE,
+		mRenderScale + MAX_RENDER_SCALE_CHANGE);
+	scale = std::round(scale / RENDER_SCALE_STEP) * RENDER_SCALE_STEP;
+	// At least one step the right way, the rounding may have undone a small change
+	scale = tooSlow ? std::min(scale, mRenderScale - RENDER_SCALE_STEP) :
+		std::max(scale, mRenderScale + RENDER_SCALE_STEP);
+	scale = std::clamp(scale, MIN_RENDER_SCALE, MAX_RENDER_SCALE);
+	if (std::fabs(scale - mRenderScale) < RENDER_SCALE_STEP / 2.0f) {
+		// Already at the limit
+		return;
+	}
+	mRenderScale = scale;
+	mScaleSamples = 0;
+	mScaleGpuTimeMs = 0.0;
+}
+
+void TextureCubeApp::reportRenderScale(const FrameContext& frame) {
+	// Offscreen there is no title, the periodic log has the numbers
+	if (mHeadless || frame.gpuTimeMs < 0.0) {
+		return;
+	}
+	std::ostringstream title;
+	title << WINDOW_TITLE << " - " << static_cast<int>(std::round(frame.renderScale * 100.0f))
+		<< "% - gpu " << std::fixed << std::setprecision(2) << frame.gpuTimeMs << " ms";
+	glfwSetWindowTitle(mWindow, title.str().c_str());
+}
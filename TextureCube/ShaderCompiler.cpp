@@ -0,0 +1,159 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "ShaderCompiler.h"
+
+// Part of every hash, change it with the compile options so the old SPIR-V is not used
+static const char* COMPILE_OPTIONS_VERSION = "vulkan1.2-performance-v1";
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// FNV-1a, good enough to tell shaders apart
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const std::string& text) {
+	// The terminator too, so "ab" + "c" and "a" + "bc" differ
+	return hashBytes(hash, text.c_str(), text.size() + 1);
+}
+
+static shaderc_shader_kind shaderKind(ShaderStage stage) {
+	switch (stage) {
+	case ShaderStage::Vertex:
+		return shaderc_vertex_shader;
+	case ShaderStage::Fragment:
+		return shaderc_fragment_shader;
+	default:
+		return shaderc_compute_shader;
+	}
+}
+
+ShaderCompiler::ShaderCompiler(const std::string& cacheDirectory) : m_cacheDirectory(cacheDirectory) {
+	std::error_code error;
+	std::filesystem::create_directories(m_cacheDirectory, error);
+	// Without the directory everything is compiled every time, but it still works
+	if (error) {
+		std::cerr << "[shaders] could not create " << m_cacheDirectory << ": "
+			<< error.message() << std::endl;
+	}
+}
+
+ShaderSource ShaderCompiler::load(const std::string& path, ShaderStage stage,
+	const std::vector<std::string>& defines) const {
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open shader " + path + "!");
+	}
+	std::ostringstream text;
+	text << file.rdbuf();
+
+	ShaderSource source{ path, stage, defines, text.str(), 0 };
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = hashString(hash, COMPILE_OPTIONS_VERSION);
+	uint32_t kind = static_cast<uint32_t>(stage);
+	hash = hashBytes(hash, &kind, sizeof(kind));
+	for (const auto& define : defines) {
+		hash = hashString(hash, define);
+	}
+	source.hash = hashString(hash, source.text);
+	return source;
+}
+
+std::vector<uint32_t> ShaderCompiler::compile(const ShaderSource& source) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<uint32_t> code = readCache(source.hash);
+	if (!code.empty()) {
+		m_cacheHits++;
+		return code;
+	}
+
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+	for (const auto& define : source.defines) {
+		size_t equals = define.find('=');
+		if (equals == std::string::npos) {
+			options.AddMacroDefinition(define);
+		} else {
+			options.AddMacroDefinition(define.substr(0, equals), define.substr(equals + 1));
+		}
+	}
+	auto start = std::chrono::steady_clock::now();
+	shaderc::SpvCompilationResult result = m_compiler.CompileGlslToSpv(source.text,
+		shaderKind(source.stage), source.path.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+		throw std::runtime_error("failed to compile shader " + source.path + "!\n" +
+			result.GetErrorMessage());
+	}
+	auto end = std::chrono::steady_clock::now();
+	code.assign(result.cbegin(), result.cend());
+	m_cacheMisses++;
+	std::cout << "[shaders] " << source.path << " compiled in "
+		<< std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+
+	writeCache(source.hash, code);
+	return code;
+}
+
+uint32_t ShaderCompiler::cacheHits() const {
+	return m_cacheHits;
+}
+
+uint32_t ShaderCompiler::cacheMisses() const {
+	return m_cacheMisses;
+}
+
+std::string ShaderCompiler::cachePath(uint64_t hash) const {
+	std::ostringstream path;
+	path << m_cacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash
+		<< ".spv";
+	return path.str();
+}
+
+std::vector<uint32_t> ShaderCompiler::readCache(uint64_t hash) const {
+	std::ifstream file(cachePath(hash), std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return {};
+	}
+	size_t size = static_cast<size_t>(file.tellg());
+	if (size == 0 || size % sizeof(uint32_t) != 0) {
+		return {};
+	}
+	std::vector<uint32_t> code(size / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(code.data()), size);
+	if (!file || code[0] != SPIRV_MAGIC) {
+		return {};
+	}
+	return code;
+}
+
+void ShaderCompiler::writeCache(uint64_t hash, const std::vector<uint32_t>& code) const {
+	std::string path = cachePath(hash);
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t));
+		file.close();
+		if (!file) {
+			std::cerr << "[shaders] could not write " << temporaryPath << std::endl;
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error) {
+		std::filesystem::remove(temporaryPath, error);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <shaderc/shaderc.hpp>
+//! Pipeline stage a shader source is written for
+enum class ShaderStage {
+	Vertex,
+	Fragment,
+	Compute
+};
+//! A GLSL source file ready to be compiled, with what identifies its SPIR-V
+struct ShaderSource {
+	//! File the text came from, used in the error messages
+	std::string path;
+	ShaderStage stage;
+	//! Preprocessor defines, "NAME" or "NAME=VALUE"
+	std::vector<std::string> defines;
+	std::string text;
+	//! Hash of everything above that changes the SPIR-V
+	uint64_t hash;
+};
+//! Compiles GLSL to SPIR-V in process, with an on disk cache of the results
+/*!
+  The cache is content addressed: every SPIR-V file is named after the hash
+  of the source text, the stage, the defines and the compile options. An
+  edited shader gets a new name, so the cache never has to be invalidated,
+  and the same source with the same defines is compiled only once, ever.
+  Safe to use from several threads.
+*/
+class ShaderCompiler {
+public:
+	//! Creates the compiler, the SPIR-V files go to the given directory
+	explicit ShaderCompiler(const std::string& cacheDirectory);
+	//! Reads a source file and hashes it with its stage and defines
+	ShaderSource load(const std::string& path, ShaderStage stage,
+		const std::vector<std::string>& defines = {}) const;
+	//! SPIR-V of the source, from the cache if it was already compiled
+	/*!
+	  Throws a std::runtime_error with the compiler log if the source is wrong
+	*/
+	std::vector<uint32_t> compile(const ShaderSource& source);
+	//! Compilations that were found in the cache
+	uint32_t cacheHits() const;
+	//! Compilations that had to run the compiler
+	uint32_t cacheMisses() const;
+
+protected:
+	//! Where the SPIR-V of the hash lives in the cache
+	std::string cachePath(uint64_t hash) const;
+	//! SPIR-V stored for the hash, empty if there is none (or it is broken)
+	std::vector<uint32_t> readCache(uint64_t hash) const;
+	//! Stores the SPIR-V, replacing the file at once so readers never see half of it
+	void writeCache(uint64_t hash, const std::vector<uint32_t>& code) const;
+
+	shaderc::Compiler m_compiler;
+	std::string m_cacheDirectory;
+	//! One compilation at a time, they share the cache files and the counters
+	std::mutex m_mutex;
+	uint32_t m_cacheHits{ 0 };
+	uint32_t m_cacheMisses{ 0 };
+};
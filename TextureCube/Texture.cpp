@@ -5,11 +5,15 @@
 
 void TextureCubeApp::createTextureFromFile(const std::string fileName, VkImage& image,
 	VkDeviceMemory& imageMemory, uint32_t& mipLevels) {
+	TRACE_FUNCTION();
 
 	// Load texture date into CPU (host) memory
 	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(fileName.c_str(),
-		&texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	stbi_uc* pixels;
+	{
+		TRACE_SCOPE("decode image");
+		pixels = stbi_load(fileName.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	}
 	VkDeviceSize imageSize = texWidth * texHeight * 4;
 
 	if (!pixels) {
@@ -18,37 +22,25 @@ void TextureCubeApp::createTextureFromFile(const std::string fileName, VkImage&
 	// Calculate the required number of mipmap levels
 	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
-	// Create a staging buffer
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
-	// Copy image data into the stagging buffer
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(mDevice, stagingBufferMemory);
-	// We can clean the CPU copy (we had date in buffer now)
-	stbi_image_free(pixels);
 	// Create Vulkan image object
 	createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
 		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
-
-	transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-	copyBufferToImage(stagingBuffer, image, static_cast<uint32_t>(texWidth),
-		static_cast<uint32_t>(texHeight));
-	// Free staging buffer
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-	// We will transition to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, while generating
-	// the mipmaps
-	generateMipmaps(image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory, MemoryCategory::Texture);
+	// The first level is copied on the transfer queue
+	UploadBatch upload = beginUpload();
+	uploadImage(upload, pixels, imageSize, image, static_cast<uint32_t>(texWidth),
+		static_cast<uint32_t>(texHeight), mipLevels);
+	// We can clean the CPU copy (we had date in the staging buffer now)
+	stbi_image_free(pixels);
+	// The graphics queue generates the mipmaps (blits need it) and
+	// leaves the image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	generateMipmaps(upload.graphicsCommands, image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, 
+		texHeight, mipLevels);
+	submitUpload(upload);
 }
 
 void TextureCubeApp::createTextureImages() {
+	TRACE_FUNCTION();
 	createTextureFromFile("textures/container2_specular.png", mSpecularTextureImage,
 		mSpecularTextureImageMemory, mSpecTextMipLevels);
 	createTextureFromFile("textures/container2.png", mDiffuseTextureImage, 
@@ -58,7 +50,20 @@ void TextureCubeApp::createTextureImages() {
 void TextureCubeApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
 	VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
 	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image,
-	VkDeviceMemory& imageMemory) {
+	VkDeviceMemory& imageMemory, MemoryCategory category) {
+	// Create the image object
+	createImageObject(width, height, mipLevels, numSamples, format, tiling, usage, image);
+	// Allocate memmory for the image
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
+	imageMemory = allocateMemory(memRequirements, properties, category);
+	// Bound image and memmory
+	vkBindImageMemory(mDevice, image, imageMemory, 0);
+}
+
+void TextureCubeApp::createImageObject(uint32_t width, uint32_t height, uint32_t mipLevels,
+	VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
+	VkImageUsageFlags usage, VkImage& image) {
 	// Prepare Vulkan image
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -80,23 +85,10 @@ void TextureCubeApp::createImage(uint32_t width, uint32_t height, uint32_t mipLe
 	// No multisampling (since this will not be attached to any FB)
 	imageInfo.samples = numSamples;
 	imageInfo.flags = 0; // Optional
-	// Create image
-	if (vkCreateImage(mDevice, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+	// Create image (memory is bound by the caller)
+	if (vkCreateImage(mDevice, &imageInfo, mHostCallbacks, &image) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create image!");
 	}
-	// Allocate memmory for the image
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-		properties);
-	if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
-	// Bound image and memmory
-	vkBindImageMemory(mDevice, image, imageMemory, 0);
 }
 
 VkCommandBuffer TextureCubeApp::beginSingleTimeCommands() {
@@ -121,13 +113,24 @@ VkCommandBuffer TextureCubeApp::beginSingleTimeCommands() {
 void TextureCubeApp::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
 	vkEndCommandBuffer(commandBuffer);
 
+	// On the frame timeline like the rest of the graphics queue, so we wait for
+	// these commands only and not for the frames in flight
+	uint64_t done = ++mFrameTimelineValue;
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &done;
+
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &mFrameTimeline;
 
 	vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(mGraphicsQueue);
+	waitFrameTimeline(done);
 
 	vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
 }
@@ -208,34 +211,8 @@ void TextureCubeApp::transitionImageLayout(VkImage image, VkFormat format, VkIma
 	endSingleTimeCommands(commandBuffer);
 }
 
-void TextureCubeApp::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = {
-		width,
-		height,
-		1
-	};
-
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1, &region);
-
-	endSingleTimeCommands(commandBuffer);
-}
-
-
 void TextureCubeApp::createTextureImageViews() {
+	TRACE_FUNCTION();
 	mSpecularTextureImageView = createImageView(mSpecularTextureImage, VK_FORMAT_R8G8B8A8_SRGB, 
 		VK_IMAGE_ASPECT_COLOR_BIT, mSpecTextMipLevels);
 	mDiffuseTextureImageView = createImageView(mDiffuseTextureImage, VK_FORMAT_R8G8B8A8_SRGB,
@@ -257,7 +234,7 @@ VkImageView TextureCubeApp::createImageView(VkImage image, VkFormat format,
 	viewInfo.subresourceRange.layerCount = 1;
 
 	VkImageView imageView;
-	if (vkCreateImageView(mDevice, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+	if (vkCreateImageView(mDevice, &viewInfo, mHostCallbacks, &imageView) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create texture image view!");
 	}
 
@@ -265,6 +242,7 @@ VkImageView TextureCubeApp::createImageView(VkImage image, VkFormat format,
 }
 
 void TextureCubeApp::createTextureSamplers() {
+	TRACE_FUNCTION();
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -290,17 +268,18 @@ void TextureCubeApp::createTextureSamplers() {
 	samplerInfo.mipLodBias = 0.0f; //optional
 
 	samplerInfo.maxLod = static_cast<float>(mSpecTextMipLevels);
-	if (vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSpecularTextureSampler) != VK_SUCCESS) {
+	if (vkCreateSampler(mDevice, &samplerInfo, mHostCallbacks, &mSpecularTextureSampler) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create texture sampler!");
 	}
 	samplerInfo.maxLod = static_cast<float>(mDiffTextMipLevels);
-	if (vkCreateSampler(mDevice, &samplerInfo, nullptr, &mDiffuseTextureSampler) != VK_SUCCESS) {
+	if (vkCreateSampler(mDevice, &samplerInfo, mHostCallbacks, &mDiffuseTextureSampler) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create texture sampler!");
 	}
 }
 
-void TextureCubeApp::generateMipmaps(VkImage image, VkFormat imageFormat,
+void TextureCubeApp::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat,
 	int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
+	TRACE_FUNCTION();
 
 	// Check if image format supports linear blitting
 	VkFormatProperties formatProperties;
@@ -309,7 +288,6 @@ void TextureCubeApp::generateMipmaps(VkImage image, VkFormat imageFormat,
 		throw std::runtime_error("texture image format does not support linear blitting!");
 	}
 
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 	// We use the same barrier for all the trasition (since they happen secuentially)
 	// all of these fields are constant
 	VkImageMemoryBarrier barrier{};
@@ -385,6 +363,4 @@ void TextureCubeApp::generateMipmaps(VkImage image, VkFormat imageFormat,
 		0, nullptr,
 		0, nullptr,
 		1, &barrier);
-
-	endSingleTimeCommands(commandBuffer);
 }
\ No newline at end of file
@@ -2,10 +2,20 @@
 #include <stdexcept>
 #include <cstdlib>
 
+#include "Options.h"
 #include "TextureCubeApp.h"
 
 int main(int argc, char* argv[]) {
-	TextureCubeApp app;
+	AppOptions options;
+	try {
+		options = parseOptions(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	TextureCubeApp app(options);
 
 	try {
 		app.run();
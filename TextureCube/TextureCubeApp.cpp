@@ -1,13 +1,82 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
 #include <stdexcept>
+#include <thread>
 
 #include "TextureCubeApp.h"
 #include "DebugLog.h"
 
+TextureCubeApp::TextureCubeApp(const AppOptions& options) : mOptions(options) {
+	mDrawMode = mOptions.instancing ? DrawMode::Instanced : DrawMode::PerInstance;
+	if (mOptions.cpuCulling) {
+		mDrawMode = DrawMode::CpuCulled;
+	}
+	mHeadless = mOptions.headless;
+	mLowLatency = mOptions.lowLatency;
+	if (mEnableValidationLayers) {
+		// Before the instance, so it also gets the messages of its creation
+		mDebugLogger = std::make_unique<DebugLogger>();
+	}
+	if (mOptions.hostAllocator) {
+		mHostCallbacks = mHostAllocator.callbacks();
+	}
+	mRecordThreads = mOptions.recordThreads;
+	if (mRecordThreads == 0) {
+		mRecordThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	// The thread that records the frame also takes a range of draws
+	mThreadPool = std::make_unique<ThreadPool>(std::max(mRecordThreads - 1, 1u));
+	mShaderCompiler = std::make_unique<ShaderCompiler>(SHADER_CACHE_PATH);
+	// Pipelines compile on their own thread, never on the recording ones
+	mPipelineManager = std::make_unique<PipelineManager>(1);
+}
+
 void TextureCubeApp::run() {
-	initWindow();
+	if (!mOptions.tracePath.empty()) {
+#ifndef TEXTURECUBE_TRACE
+		std::cerr << "[trace] built without TEXTURECUBE_TRACE, the trace will be empty" << std::endl;
+#endif
+		Tracer::enable();
+		Tracer::setThreadName("main");
+	}
+	// Pure CPU work, no need for a window or a device
+	if (mOptions.benchmarkCulling) {
+		benchmarkCulling();
+		return;
+	}
+	if (mHeadless) {
+		// Nothing to drag, but the camera still needs the viewport size
+		mTrackball = Trackball(mWidth, mHeight);
+	} else {
+		initWindow();
+	}
 	initVulkan();
-	mainLoop();
+	if (mOptions.benchmarkRecording) {
+		benchmarkRecording();
+	} else if (mOptions.benchmarkInstancing) {
+		benchmarkInstancing();
+	} else if (mOptions.benchmarkResize) {
+		benchmarkResize();
+	} else if (mOptions.benchmarkFrames) {
+		benchmarkFrames();
+	} else if (mOptions.verifyCulling) {
+		verifyCulling();
+	} else if (mOptions.verifyGeometryPool) {
+		verifyGeometryPool();
+	} else {
+		mainLoop();
+	}
 	cleanup();
+	// With everything destroyed, whatever is still live was leaked by somebody
+	logHostAllocationStats();
+	// Every other thread is idle (or gone) by now
+	if (!mOptions.tracePath.empty()) {
+		if (!Tracer::write(mOptions.tracePath)) {
+			throw std::runtime_error("failed to write trace " + mOptions.tracePath + "!");
+		}
+		std::cout << "[trace] written to " << mOptions.tracePath << std::endl;
+	}
 }
 
 void TextureCubeApp::initWindow() {
@@ -15,7 +84,7 @@ void TextureCubeApp::initWindow() {
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-	mWindow = glfwCreateWindow(mWidth, mHeight, "Textured cube in Vulkan", nullptr, nullptr);
+	mWindow = glfwCreateWindow(mWidth, mHeight, WINDOW_TITLE.c_str(), nullptr, nullptr);
 	mTrackball = Trackball(mWidth, mHeight);
 	// Register this pointer with GLFW (so we can use it in static callbacks)
 	glfwSetWindowUserPointer(mWindow, this);
@@ -75,83 +144,153 @@ static void mouseButtonCallback(GLFWwindow* window, int button, int action, int
 }
 
 void TextureCubeApp::initVulkan() {
+	TRACE_FUNCTION();
 	createInstance();
 	setupDebugMessenger();
-	createSurface();
+	if (!mHeadless) {
+		createSurface();
+	}
 	pickPhysicalDevice();
+	if (mHeadless) {
+		logHeadlessDevice();
+	}
 	createLogicalDevice();
+	initMemoryTracking();
+	createPipelineCache();
+	// Before the swapchain, its images and the render pass depend on it
+	initDynamicResolution();
 	createSwapChain();
 	createImageViews();
 	createRenderPass();
 	createDescriptorSetLayout();
 	createGraphicsPipeline();
 	createCommandPool();
-	createColorResources();
-	createDepthResources();
+	createFrameTimeline();
+	createUploadResources();
+	createTransientAttachments();
+	createSceneTarget();
+#ifndef NDEBUG
+	reportAttachmentMemory();
+#endif
 	createFramebuffers();
 	createTextureImages();
 	createTextureImageViews();
 	createTextureSamplers();
 	loadModel();
-	createVertexBuffer();
-	createIndexBuffer();
+	// The scene is a single mesh for now, it goes through the transfer queue and
+	// the frames wait for it on the GPU so nothing stalls here
+	createGeometryPool();
+	mSceneMesh = addMesh(mVertices, mIndices);
+	generateInstances(mOptions.instanceCount);
+	createInstanceBuffer();
+	createFrameContexts();
 	createUniformBuffers();
 	createDescriptorPool();
 	createDescriptorSets();
-	createCommandBuffers();
-	createSyncObjects();
+	// Compute culling needs a few optional features, without them draw everything
+	mGpuCulling = (mOptions.gpuCulling || mOptions.verifyCulling) && mGpuCullingSupported;
+	if (mGpuCulling) {
+		createCullingPipeline();
+		createCullingResources();
+		mDrawMode = DrawMode::GpuCulled;
+	} else if (mOptions.gpuCulling || mOptions.verifyCulling) {
+		std::cerr << "gpu culling not supported by the device, drawing every instance" << std::endl;
+	}
 }
 
 void TextureCubeApp::mainLoop() {
-	while (!glfwWindowShouldClose(mWindow)) {
-		glfwPollEvents();
+	// Without a window there is nothing to close, so stop after a while
+	uint32_t frameLimit = mOptions.frameCount;
+	if (mHeadless && frameLimit == 0) {
+		frameLimit = HEADLESS_FRAME_COUNT;
+	}
+	for (uint32_t frame = 0; frameLimit == 0 || frame < frameLimit; frame++) {
+		if (!mHeadless && glfwWindowShouldClose(mWindow)) {
+			break;
+		}
+		pollEvents();
 		drawFrame();
+		// Every now and then let us know how the memory looks like
+		auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<float>(now - mLastMemoryLog).count() > MEMORY_LOG_PERIOD) {
+			logMemoryStats();
+			logHostAllocationStats();
+			logGeometryStats();
+			std::cout << "[draws] " << mBindStats.draws << " draws, " << mBindStats.binds
+				<< " binds, " << mBindStats.elided << " elided" << std::endl;
+			logGpuTimes();
+			if (mDynamicResolution) {
+				std::cout << std::fixed << std::setprecision(3) << "[resolution] scale "
+					<< static_cast<int>(std::round(mRenderScale * 100.0f)) << "%, gpu "
+					<< mScaleGpuTimeMs << " ms (target " << mOptions.targetGpuMs << ")"
+					<< std::defaultfloat << std::endl;
+			}
+			mLastMemoryLog = now;
+		}
+		flushPipelineCache();
 	}
 
 	vkDeviceWaitIdle(mDevice);
 }
 
 void TextureCubeApp::cleanup() {
+	TRACE_FUNCTION();
 	cleanupSwapChain();
+	destroyRenderPipeline();
+	destroyUniformBuffers();
 
-	vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		vkDestroySemaphore(mDevice, mRenderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(mDevice, mImageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(mDevice, mInFlightFences[i], nullptr);
-	}
+	vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, mHostCallbacks);
 
-	vkDestroySampler(mDevice, mSpecularTextureSampler, nullptr);
-	vkDestroyImageView(mDevice, mSpecularTextureImageView, nullptr);
-	vkDestroyImage(mDevice, mSpecularTextureImage, nullptr);
-	vkFreeMemory(mDevice, mSpecularTextureImageMemory, nullptr);
+	vkDestroySampler(mDevice, mSpecularTextureSampler, mHostCallbacks);
+	vkDestroyImageView(mDevice, mSpecularTextureImageView, mHostCallbacks);
+	vkDestroyImage(mDevice, mSpecularTextureImage, mHostCallbacks);
+	freeMemory(mSpecularTextureImageMemory);
 
-	vkDestroySampler(mDevice, mDiffuseTextureSampler, nullptr);
-	vkDestroyImageView(mDevice, mDiffuseTextureImageView, nullptr);
-	vkDestroyImage(mDevice, mDiffuseTextureImage, nullptr);
-	vkFreeMemory(mDevice, mDiffuseTextureImageMemory, nullptr);
+	vkDestroySampler(mDevice, mDiffuseTextureSampler, mHostCallbacks);
+	vkDestroyImageView(mDevice, mDiffuseTextureImageView, mHostCallbacks);
+	vkDestroyImage(mDevice, mDiffuseTextureImage, mHostCallbacks);
+	freeMemory(mDiffuseTextureImageMemory);
 
-	vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
-	vkFreeMemory(mDevice, mIndexBufferMemory, nullptr);
-	vkDestroyBuffer(mDevice, mVertexBuffer, nullptr);
-	vkFreeMemory(mDevice, mVertexBufferMemory, nullptr);
+	destroyInstanceBuffer();
+	destroyGeometryPool();
 
-	vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
-	vkDestroyDevice(mDevice, nullptr);
+	if (mGpuCulling) {
+		destroyCullingResources();
+		destroyCullingPipeline();
+	}
+	destroyFrameContexts();
+	destroyUploadResources();
+	vkDestroySemaphore(mDevice, mFrameTimeline, mHostCallbacks);
+	vkDestroyCommandPool(mDevice, mCommandPool, mHostCallbacks);
+	destroyShaderModules();
+	destroyPipelineCache();
+	vkDestroyDevice(mDevice, mHostCallbacks);
 
 	if (mEnableValidationLayers) {
-		DestroyDebugUtilsMessengerEXT(mInstance, mDebugMessenger, nullptr);
+		DestroyDebugUtilsMessengerEXT(mInstance, mDebugMessenger, mHostCallbacks);
+	}
+
+	if (!mHeadless) {
+		vkDestroySurfaceKHR(mInstance, mSurface, mHostCallbacks);
 	}
+	vkDestroyInstance(mInstance, mHostCallbacks);
+	// Nothing can report anymore, print what is left
+	mDebugLogger.reset();
 
-	vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
-	vkDestroyInstance(mInstance, nullptr);
+	if (!mHeadless) {
+		glfwDestroyWindow(mWindow);
+		glfwTerminate();
+	}
+}
 
-	glfwDestroyWindow(mWindow);
-	glfwTerminate();
+void TextureCubeApp::pollEvents() {
+	if (!mHeadless) {
+		glfwPollEvents();
+	}
 }
 
 void TextureCubeApp::createInstance() {
+	TRACE_FUNCTION();
 	if (mEnableValidationLayers && !checkValidationLayerSupport()) {
 		throw std::runtime_error("validation layers requested, but not available!");
 	}
@@ -163,7 +302,8 @@ void TextureCubeApp::createInstance() {
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// 1.2 for the timeline semaphores (and vkGetPhysicalDeviceMemoryProperties2)
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 	// To pass it we need to wrap in in another create info
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -189,8 +329,8 @@ void TextureCubeApp::createInstance() {
 	}
 
 	// Finally, we are ready to create the instance
-	VkResult result = vkCreateInstance(&createInfo, nullptr, &mInstance);
-	if (vkCreateInstance(&createInfo, nullptr, &mInstance) != VK_SUCCESS) {
+	VkResult result = vkCreateInstance(&createInfo, mHostCallbacks, &mInstance);
+	if (result != VK_SUCCESS) {
 		throw std::runtime_error("failed to create instance!");
 	}
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #define GLFW_INCLUDE_VULKAN
@@ -10,9 +15,24 @@
 #include "Trackball.h"
 #include "Vertex.h"
 #include "Device.h"
+#include "Attachments.h"
+#include "Memory.h"
+#include "HostAllocator.h"
+#include "Upload.h"
+#include "Frame.h"
+#include "Options.h"
+#include "ThreadPool.h"
+#include "FrustumCuller.h"
+#include "RenderQueue.h"
+#include "GeometryPool.h"
+#include "PipelineManager.h"
+#include "ShaderCompiler.h"
+#include "Trace.h"
+#include "DebugLogger.h"
 
 class TextureCubeApp {
 public:
+	explicit TextureCubeApp(const AppOptions& options = AppOptions{});
 	void run();
 	bool mFramebufferResized{ false };
 	bool mRotate{ true };
@@ -22,15 +42,66 @@ public:
 	int mZoomLevel{ 0 };       //Zoom level to complement the trackball camera
 private:
 	// App logic
+	AppOptions mOptions;
+	// Host memory of the driver. Declared before anything Vulkan, so it is destroyed last
+	HostAllocator mHostAllocator;
+	// What the vkCreate and vkDestroy calls get, null to use the driver's own heap
+	const VkAllocationCallbacks* mHostCallbacks{ nullptr };
 	const uint32_t mWidth{ 800 };
 	const uint32_t mHeight{ 600 };
+	const std::string WINDOW_TITLE{ "Textured cube in Vulkan" };
 	const std::string MODEL_PATH{ "models/viking_room.obj" };
 	const std::string TEXTURE_PATH{ "textures/viking_room.png" };
+	// Headless mode: offscreen images instead of a window, a surface and a swapchain
+	bool mHeadless{ false };
+	const uint32_t OFFSCREEN_IMAGE_COUNT{ 3 };
+	const uint32_t HEADLESS_FRAME_COUNT{ 300 };
+	std::vector<VkDeviceMemory> mOffscreenMemories;
+	uint32_t mOffscreenImage{ 0 };
+	// Low latency mode: one frame queued for the display at most, the input sampled
+	// right before recording, and the time from that input to the screen
+	bool mLowLatency{ false };
+	bool mPresentWaitSupported{ false };
+#ifdef VK_KHR_present_wait
+	PFN_vkWaitForPresentKHR mWaitForPresent{ nullptr };
+#endif
+	uint64_t mPresentId{ 0 };
+	std::chrono::steady_clock::time_point mInputTime;
+	PendingPresent mPendingPresent;
+	// Nanoseconds, a hidden or minimized window may never present
+	const uint64_t PRESENT_WAIT_TIMEOUT{ 100000000 };
+	// Dynamic resolution: the scene renders into the top left part of the scene
+	// image, as big as the scale, and a blit stretches it over the swapchain image.
+	// The image has the full size, so changing the scale allocates nothing
+	bool mDynamicResolution{ false };
+	VkImage mSceneImage{ VK_NULL_HANDLE };
+	VkDeviceMemory mSceneImageMemory{ VK_NULL_HANDLE };
+	VkImageView mSceneImageView{ VK_NULL_HANDLE };
+	float mRenderScale{ 1.0f };
+	// Average GPU time of the frames rendered at the current scale, and how many
+	double mScaleGpuTimeMs{ 0.0 };
+	uint32_t mScaleSamples{ 0 };
+	const float MIN_RENDER_SCALE{ 0.5f };
+	const float MAX_RENDER_SCALE{ 1.0f };
+	// The scale moves in these steps, and at most this much at a time
+	const float RENDER_SCALE_STEP{ 0.05f };
+	const float MAX_RENDER_SCALE_CHANGE{ 0.1f };
+	// Between this part of the target and the target the scale holds (hysteresis),
+	// otherwise it aims for the middle of that band
+	const double SCALE_UP_THRESHOLD{ 0.8 };
+	// Frames at a new scale before its average is trusted
+	const uint32_t SCALE_SETTLE_FRAMES{ 8 };
+	// Weight of a new frame in the average, once past the settle frames
+	const double GPU_TIME_SMOOTHING{ 0.1 };
+	const std::string PIPELINE_CACHE_PATH{ "pipeline_cache.bin" };
+	const std::string SHADER_CACHE_PATH{ "shader_cache" };
 	// Model loading
 	std::vector<Vertex> mVertices;
 	std::vector<uint32_t> mIndices;
-	// To help with syncronization
-	const int MAX_FRAMES_IN_FLIGHT{ 2 };
+	// Draws a recording thread takes at least, below that one thread is faster
+	const uint32_t MIN_DRAWS_PER_THREAD{ 256 };
+	// Seconds between two memory log lines
+	const float MEMORY_LOG_PERIOD{ 5.0f };
 	// GLFW related
 	GLFWwindow* mWindow{ nullptr };
 	// Vulkan related
@@ -38,32 +109,86 @@ private:
 	VkDebugUtilsMessengerEXT mDebugMessenger{};
 	VkQueue mGraphicsQueue;
 	VkQueue mPresentQueue;
+	VkQueue mTransferQueue;
 	VkSurfaceKHR mSurface;
 	VkRenderPass mRenderPass;
 	VkDescriptorSetLayout mDescriptorSetLayout;
+	// Holds the descriptor set of every frame in flight
 	VkDescriptorPool mDescriptorPool;
-	std::vector<VkDescriptorSet> mDescriptorSets;
 	VkPipelineLayout mPipelineLayout;
+	// The fallback pipeline, built synchronously so there is always one to draw with
 	VkPipeline mGraphicsPipeline;
-	VkBuffer mVertexBuffer;
-	VkDeviceMemory mVertexBufferMemory;
-	VkBuffer mIndexBuffer;
-	VkDeviceMemory mIndexBufferMemory;
-	std::vector<VkBuffer> mUniformBuffers;
-	std::vector<VkDeviceMemory> mUniformBuffersMemory;
+	// Pipelines by the id the render keys use, the fallback is not one of them.
+	// Every permutation gets one id, however many materials ask for it
+	std::vector<PipelineVariant> mPipelineVariants;
+	std::unordered_map<uint64_t, uint32_t> mPipelineIds;
+	// Handles every material in the same draw, for the single draw modes
+	uint32_t mScenePipeline{ 0 };
+	// Specialized for each material, for the per instance draws
+	std::vector<uint32_t> mMaterialPipelines;
+	// Shaders compiled at runtime, each module shared by every pipeline using it
+	std::unique_ptr<ShaderCompiler> mShaderCompiler;
+	std::unordered_map<uint64_t, VkShaderModule> mShaderModules;
+	std::mutex mShaderModulesMutex;
+	// Compiles every variant but the fallback in the background
+	std::unique_ptr<PipelineManager> mPipelineManager;
+	// Pipeline of every id for the frame being recorded, the fallback until ready
+	std::vector<VkPipeline> mPipelineTable;
+	// Geometry pool: every mesh lives in these two buffers, at the ranges of mMeshes
+	const uint32_t GEOMETRY_VERTEX_CAPACITY{ 1u << 20 };
+	const uint32_t GEOMETRY_INDEX_CAPACITY{ 1u << 22 };
+	VkBuffer mGeometryVertexBuffer;
+	VkDeviceMemory mGeometryVertexMemory;
+	VkBuffer mGeometryIndexBuffer;
+	VkDeviceMemory mGeometryIndexMemory;
+	RangeAllocator mVertexRanges;
+	RangeAllocator mIndexRanges;
+	std::vector<MeshRange> mMeshes;
+	// The mesh the scene instances draw
+	uint32_t mSceneMesh{ 0 };
+	// One uniform buffer for all the frames in flight, each writes its own slice
+	VkBuffer mUniformBuffer;
+	VkDeviceMemory mUniformMemory;
 	std::vector<VkFramebuffer> mSwapChainFramebuffers;
 	VkCommandPool mCommandPool;
-	std::vector<VkCommandBuffer> mCommandBuffers;
+	// Per frame in flight resources, as many as --frames-in-flight
+	std::vector<FrameContext> mFrames;
+	// Multithreaded recording
+	uint32_t mRecordThreads{ 1 };
+	std::unique_ptr<ThreadPool> mThreadPool;
+	// Copies of the mesh drawn each frame
+	const uint32_t MATERIAL_COUNT{ 4 };
+	std::vector<InstanceData> mInstances;
+	std::vector<glm::vec4> mInstanceBounds;
+	DrawMode mDrawMode{ DrawMode::Instanced };
+	VkBuffer mInstanceBuffer;
+	VkDeviceMemory mInstanceBufferMemory;
+	VkBuffer mBoundsBuffer;
+	VkDeviceMemory mBoundsBufferMemory;
+	// GPU culling, the frustum comes from the matrices of the last uniform update
+	bool mGpuCullingSupported{ false };
+	bool mGpuCulling{ false };
+	Frustum mFrustum{};
+	// CPU culling, the visible list is rebuilt every frame
+	FrustumCuller mCuller;
+	std::vector<uint32_t> mVisibleInstances;
+	// Per instance draws, sorted to skip the binds that are already current
+	RenderQueue mRenderQueue;
+	BindStats mBindStats;
+	VkDescriptorSetLayout mCullingSetLayout;
+	VkPipelineLayout mCullingPipelineLayout;
+	VkPipeline mCullingPipeline;
+	VkDescriptorPool mCullingDescriptorPool;
 	// Vulkan's swapchain related
 	VkSwapchainKHR mSwapChain;
 	VkFormat mSwapChainImageFormat;
 	VkExtent2D mSwapChainExtent;
 	std::vector<VkImage> mSwapChainImages;
 	std::vector<VkImageView> mSwapChainImageViews;
+	SwapChainStats mSwapChainStats;
 	// Multisample
 	VkSampleCountFlagBits mMsaaSamples{ VK_SAMPLE_COUNT_1_BIT };
 	VkImage mColorImage;
-	VkDeviceMemory mColorImageMemory;
 	VkImageView mColorImageView;
 	// Texture image
 	// For specular texture
@@ -80,17 +205,56 @@ private:
 	VkSampler mDiffuseTextureSampler;
 	// Depth buffer
 	VkImage mDepthImage;
-	VkDeviceMemory mDepthImageMemory;
 	VkImageView mDepthImageView;
-	// Syncronization
-	std::vector <VkSemaphore> mImageAvailableSemaphores;
-	std::vector <VkSemaphore> mRenderFinishedSemaphores;
-	std::vector<VkFence> mInFlightFences;
-	std::vector<VkFence> mImagesInFlight;
+	// Shared memory block for the transient attachments (MSAA color and depth)
+	VkDeviceMemory mTransientMemory;
+	VkDeviceSize mTransientMemorySize{ 0 };
+	bool mTransientMemoryLazy{ false };
+	// Syncronization, the frame in flight being recorded
 	size_t mCurrentFrame{ 0 };
+	// Everything submitted to the graphics queue (the frames and the graphics side
+	// of the uploads) signals the next value, so one number tells how far it is
+	VkSemaphore mFrameTimeline;
+	uint64_t mFrameTimelineValue{ 0 };
+	// Frames submitted so far
+	uint64_t mFrameNumber{ 0 };
+	// GPU times of the frames, and of the uploads on each of their queues
+	std::unique_ptr<GpuProfiler> mFrameProfiler;
+	std::unique_ptr<GpuProfiler> mTransferProfiler;
+	std::unique_ptr<GpuProfiler> mUploadProfiler;
+	// The profilers reset their queries from the host, if the device lets them
+	bool mHostQueryResetSupported{ false };
+	const uint32_t MAX_GPU_SCOPES{ 8 };
+	const uint32_t UPLOAD_PROFILER_SLOTS{ 8 };
+	uint32_t mNextUploadSlot{ 0 };
+	// Seconds the animation advances every frame, 0 follows the clock instead
+	float mFixedTimeStep{ 0.0f };
+	float mSimulationTime{ 0.0f };
 	// Device related
 	VkPhysicalDevice mPhysicalDevice{ VK_NULL_HANDLE };
 	VkDevice mDevice{ VK_NULL_HANDLE };
+	// Memory related
+	VkPhysicalDeviceMemoryProperties mMemProperties{};
+	bool mMemoryBudgetSupported{ false };
+	std::unordered_map<VkDeviceMemory, MemoryAllocation> mAllocations;
+	MemoryStats mMemoryStats;
+	std::chrono::steady_clock::time_point mLastMemoryLog;
+	// Pipeline cache, loaded at startup and saved back at shutdown
+	VkPipelineCache mPipelineCache{ VK_NULL_HANDLE };
+	std::atomic<bool> mPipelineCacheWarm{ false };
+	size_t mPipelineCacheSavedSize{ 0 };
+	std::chrono::steady_clock::time_point mLastPipelineCacheFlush;
+	// Asynchronous uploads
+	uint32_t mGraphicsFamily;
+	uint32_t mTransferFamily;
+	VkCommandPool mTransferCommandPool;
+	// Only the copies signal it, a timeline only moves forward and the transfer
+	// queue runs alongside the graphics one
+	VkSemaphore mTransferTimeline;
+	uint64_t mTransferTimelineValue{ 0 };
+	// Value of mFrameTimeline the last upload signals, the frames wait for it
+	uint64_t mLastUploadValue{ 0 };
+	std::vector<UploadBatch> mPendingUploads;
 	// Enable validation layers and debug
 	const std::vector<const char*> mValidationLayers = {
 		"VK_LAYER_KHRONOS_validation"
@@ -104,6 +268,8 @@ private:
 #else
 	const bool mEnableValidationLayers = true;
 #endif
+	// Prints the validation messages away from the driver calls that trigger them
+	std::unique_ptr<DebugLogger> mDebugLogger;
 	// General program flow functions
 	void initWindow();
 	void initVulkan();
@@ -116,40 +282,135 @@ private:
 	// Prepare the render target functions
 	void createSurface();
 	void createSwapChain();
-	void recreateSwapChain();
+	void recreateSwapChain(bool rebuildAll = false);
+	// Headless
+	void createOffscreenImages();
+	void destroyOffscreenImages();
+	uint32_t acquireOffscreenImage();
+	void logHeadlessDevice();
+	void pollEvents();
+	// Low latency
+	void pollQueuedFrame();
+	void waitForQueuedFrame();
+	void sampleInput();
+	// Dynamic resolution
+	void initDynamicResolution();
+	void createSceneTarget();
+	void destroySceneTarget();
+	VkExtent2D scaledExtent(float scale);
+	void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkExtent2D renderExtent);
+	void updateRenderScale(const FrameContext& frame);
+	void reportRenderScale(const FrameContext& frame);
 	void cleanupSwapChain();
+	void destroyRenderPipeline();
+	void destroyUniformBuffers();
 	void createImageViews();
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-	VkShaderModule createShaderModule(const std::vector<char>& code);
+	VkShaderModule createShaderModule(const std::vector<uint32_t>& code);
+	VkShaderModule getShaderModule(const std::string& path, ShaderStage stage,
+		const std::vector<std::string>& defines = {});
+	void destroyShaderModules();
+	// Pipeline cache persisted across runs
+	void createPipelineCache();
+	void savePipelineCache();
+	void flushPipelineCache();
+	void destroyPipelineCache();
 	// Pipeline functions
 	void createGraphicsPipeline();
+	VkPipeline buildGraphicsPipeline(const PipelineVariant& variant);
+	uint32_t requestPipeline(const PipelineVariant& variant);
+	void resolvePipelines();
 	void createRenderPass();
 	void createDescriptorPool();
 	// Comand recording
 	void createCommandPool();
-	void createCommandBuffers();
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	VkSemaphore createTimelineSemaphore();
+	void createFrameTimeline();
+	void waitFrameTimeline(uint64_t value);
+	void createFrameContexts();
+	void destroyFrameContexts();
+	void retireFrames();
+	void createRecordingCommands(VkCommandBufferLevel level, RecordingCommands& commands);
+	void resetFrameCommands(FrameContext& frame);
+	void collectFrameTimes(FrameContext& frame);
+	void logGpuTimes();
+	void recordCommandBuffer(FrameContext& frame, uint32_t imageIndex, uint32_t instanceCount,
+		uint32_t threadCount, DrawMode mode);
+	void recordDrawRange(FrameContext& frame, uint32_t worker, uint32_t imageIndex,
+		uint32_t firstInstance, uint32_t lastInstance, DrawMode mode, BoundState& state);
+	void buildRenderQueue(const std::vector<uint32_t>* instances, uint32_t count);
+	void bindDrawState(VkCommandBuffer commandBuffer, BoundState& state, uint64_t key,
+		VkDescriptorSet descriptorSet);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, MemoryCategory category);
 	// Render
-	void createSyncObjects();
 	void drawFrame();
 	// Buffere management
-	void createVertexBuffer();
-	void createIndexBuffer();
+	void createGeometryPool();
+	void destroyGeometryPool();
+	uint32_t addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	void removeMesh(uint32_t mesh);
+	void compactGeometryPool();
+	void logGeometryStats();
+	void verifyGeometryPool();
+	void generateInstances(uint32_t count);
+	void createInstanceBuffer();
+	void destroyInstanceBuffer();
+	void resizeInstances(uint32_t count);
+	// GPU culling
+	void createCullingPipeline();
+	void destroyCullingPipeline();
+	void createCullingResources();
+	void destroyCullingResources();
+	void recordCulling(FrameContext& frame, uint32_t objectCount);
+	void verifyCulling();
 	void createFramebuffers();
 	void createUniformBuffers();
-	void updateUniformBuffer(uint32_t currentImage);
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+	void updateUniformBuffer(FrameContext& frame);
+	// Asynchronous uploads
+	void createUploadResources();
+	void destroyUploadResources();
+	UploadBatch beginUpload();
+	VkBuffer stageUploadData(UploadBatch& batch, const void* data, VkDeviceSize size);
+	void uploadBuffer(UploadBatch& batch, const void* data, VkDeviceSize size,
+		VkBuffer dstBuffer, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage,
+		VkDeviceSize dstOffset = 0);
+	void uploadImage(UploadBatch& batch, const void* pixels, VkDeviceSize size,
+		VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+	void submitUpload(UploadBatch& batch);
+	void releaseFinishedUploads();
+	// Benchmarks
+	void benchmarkRecording();
+	void benchmarkInstancing();
+	void benchmarkCulling();
+	void benchmarkResize();
+	void benchmarkFrames();
+	void scriptCamera(float time);
 	// Uniforms management
 	void createDescriptorSetLayout();
 	void createDescriptorSets();
+	// Memory management
+	void initMemoryTracking();
+	void updateMemoryBudget();
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	std::optional<uint32_t> findOptionalMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	bool fitsMemoryBudget(uint32_t memoryType, VkDeviceSize size);
+	VkDeviceMemory allocateMemory(const VkMemoryRequirements& requirements,
+		VkMemoryPropertyFlags properties, MemoryCategory category);
+	void freeMemory(VkDeviceMemory memory);
+	MemoryStats getMemoryStats();
+	void logMemoryStats();
+	void logHostAllocationStats();
 	// Multisample
 	VkSampleCountFlagBits getMaxUsableSampleCount();
 	void createColorResources();
 	// Depth buffer
 	void createDepthResources();
+	// Transient attachments
+	void createTransientAttachments();
+	void allocateTransientMemory(std::vector<TransientAttachment>& attachments);
+	void reportAttachmentMemory();
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
 		VkImageTiling tiling, VkFormatFeatureFlags features);
 	VkFormat findDepthFormat();
@@ -165,13 +426,15 @@ private:
 	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
 		VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
 		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image,
-		VkDeviceMemory& imageMemory);
+		VkDeviceMemory& imageMemory, MemoryCategory category);
+	void createImageObject(uint32_t width, uint32_t height, uint32_t mipLevels,
+		VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
+		VkImageUsageFlags usage, VkImage& image);
 	VkCommandBuffer beginSingleTimeCommands();
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
 		VkImageLayout newLayout, uint32_t mipLevels);
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-	void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 	// Vulkan initialization functions
 	void createInstance();
 	std::vector<const char*> getRequiredExtensions();
@@ -181,6 +444,7 @@ private:
 	bool isDeviceSuitable(VkPhysicalDevice device);
 	void createLogicalDevice();
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 	// Validation layer and debug logger support
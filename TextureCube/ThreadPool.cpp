@@ -0,0 +1,46 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threadCount) {
+	if (threadCount == 0) {
+		// hardware_concurrency can return 0 when it does not know
+		threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	}
+	m_workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+size_t ThreadPool::size() const {
+	return m_workers.size();
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+			// Only leave once the queue is drained, nobody waits forever on a future
+			if (m_stop && m_tasks.empty()) {
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+	}
+}
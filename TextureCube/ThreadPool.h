@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+//! A fixed set of worker threads that run the tasks given to them
+/*!
+  The threads are created once with the pool and wait on a queue of tasks, so
+  handing work to them every frame does not pay for creating threads. Each
+  submitted task returns a std::future, that can be used to wait for the task
+  (and to get its result or the exception it threw).
+*/
+class ThreadPool {
+public:
+	//! Creates the pool with the given number of worker threads
+	/*!
+	  With 0 threads the pool uses one per hardware thread
+	*/
+	explicit ThreadPool(size_t threadCount = 0);
+	//! Waits for the pending tasks and joins the worker threads
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	//! Number of worker threads of the pool
+	size_t size() const;
+	//! Queue a task to be run by any of the worker threads
+	template<typename F>
+	std::future<std::invoke_result_t<F>> submit(F&& task);
+
+protected:
+	//! What every worker thread runs until the pool is destroyed
+	void workerLoop();
+	//! The worker threads
+	std::vector<std::thread> m_workers;
+	//! Tasks waiting for a free worker
+	std::queue<std::function<void()>> m_tasks;
+	//! Protects the task queue and the stop flag
+	std::mutex m_mutex;
+	//! Wakes the workers up when there are new tasks (or when stopping)
+	std::condition_variable m_condition;
+	//! Set when the pool is destroyed
+	bool m_stop{ false };
+};
+
+template<typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::submit(F&& task) {
+	using Result = std::invoke_result_t<F>;
+	// std::function needs to be copyable, so the packaged task goes in a shared_ptr
+	auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+	std::future<Result> result = packaged->get_future();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.emplace([packaged]() { (*packaged)(); });
+	}
+	m_condition.notify_one();
+	return result;
+}
@@ -0,0 +1,118 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Trace.h"
+
+// The ring of a thread. Only its thread writes it, the count is atomic so the
+// writer of the trace sees every event the thread finished
+struct ThreadEvents {
+	uint32_t threadId;
+	std::string threadName;
+	std::vector<Tracer::Event> events;
+	std::atomic<size_t> count{ 0 };
+};
+
+static std::atomic<bool> sEnabled{ false };
+static size_t sEventsPerThread = 0;
+static std::chrono::steady_clock::time_point sStart;
+// Every ring ever registered. They outlive their threads, so the trace still
+// has the scopes of threads that are gone when it is written
+static std::mutex sThreadsMutex;
+static std::vector<std::unique_ptr<ThreadEvents>> sThreads;
+static thread_local ThreadEvents* tThreadEvents = nullptr;
+
+static ThreadEvents& threadEvents() {
+	if (tThreadEvents == nullptr) {
+		// Only the first scope of every thread takes the lock
+		auto events = std::make_unique<ThreadEvents>();
+		events->events.resize(sEventsPerThread);
+		std::lock_guard<std::mutex> lock(sThreadsMutex);
+		events->threadId = static_cast<uint32_t>(sThreads.size()) + 1;
+		events->threadName = "thread " + std::to_string(events->threadId);
+		tThreadEvents = events.get();
+		sThreads.push_back(std::move(events));
+	}
+	return *tThreadEvents;
+}
+
+// Names are ours, but a quote or a backslash would still break the JSON
+static void writeJsonString(std::ofstream& out, const std::string& text) {
+	out << '"';
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			out << '\\';
+		}
+		out << c;
+	}
+	out << '"';
+}
+
+void Tracer::enable(size_t eventsPerThread) {
+	if (sEnabled) {
+		return;
+	}
+	sEventsPerThread = eventsPerThread;
+	sStart = std::chrono::steady_clock::now();
+	sEnabled = true;
+}
+
+bool Tracer::enabled() {
+	return sEnabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::setThreadName(const std::string& name) {
+	if (!enabled()) {
+		return;
+	}
+	ThreadEvents& events = threadEvents();
+	std::lock_guard<std::mutex> lock(sThreadsMutex);
+	events.threadName = name;
+}
+
+int64_t Tracer::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - sStart).count();
+}
+
+void Tracer::record(const char* name, int64_t start, int64_t end) {
+	ThreadEvents& events = threadEvents();
+	size_t count = events.count.load(std::memory_order_relaxed);
+	events.events[count % events.events.size()] = Event{ name, start, end - start };
+	events.count.store(count + 1, std::memory_order_release);
+}
+
+bool Tracer::write(const std::string& path) {
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(sThreadsMutex);
+	out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	for (const auto& thread : sThreads) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+			<< thread->threadId << ",\"args\":{\"name\":";
+		writeJsonString(out, thread->threadName);
+		out << "}}";
+		first = false;
+		// Only the last ones survive a full ring, oldest first
+		size_t count = thread->count.load(std::memory_order_acquire);
+		size_t capacity = thread->events.size();
+		size_t begin = count > capacity ? count - capacity : 0;
+		for (size_t i = begin; i < count; i++) {
+			const Event& event = thread->events[i % capacity];
+			// Chrome wants microseconds
+			out << ",\n{\"name\":";
+			writeJsonString(out, event.name);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->threadId
+				<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+		}
+	}
+	out << "\n]}\n";
+	return static_cast<bool>(out);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+//! Records scopes of CPU work and writes them as a Chrome trace
+/*!
+  Every thread writes its scopes into its own ring buffer, so recording takes
+  no locks (only the first scope of a thread registers its buffer). When a
+  ring is full the oldest scopes are overwritten. The trace is written with
+  \fn write, once the threads are done, and can be opened with
+  chrome://tracing or https://ui.perfetto.dev.
+  Scopes are recorded with the TRACE_SCOPE and TRACE_FUNCTION macros, which
+  compile to nothing unless TEXTURECUBE_TRACE is defined. Even then nothing
+  is recorded until \fn enable is called.
+*/
+class Tracer {
+public:
+	//! A finished scope, times in nanoseconds since the tracer was enabled
+	struct Event {
+		const char* name;
+		int64_t start;
+		int64_t duration;
+	};
+	//! Starts recording, keeping up to the given number of scopes per thread
+	static void enable(size_t eventsPerThread = 1 << 16);
+	static bool enabled();
+	//! Name of the calling thread in the trace
+	static void setThreadName(const std::string& name);
+	//! Nanoseconds since the tracer was enabled
+	static int64_t now();
+	//! Adds a scope to the ring of the calling thread
+	/*!
+	  The name is not copied, it must outlive the tracer (a string literal)
+	*/
+	static void record(const char* name, int64_t start, int64_t end);
+	//! Writes every recorded scope as a Chrome trace JSON file
+	/*!
+	  Must not be called while other threads are still recording
+	*/
+	static bool write(const std::string& path);
+};
+
+//! Records the time from its construction to its destruction
+class TraceScope {
+public:
+	explicit TraceScope(const char* name) : m_name(Tracer::enabled() ? name : nullptr) {
+		if (m_name != nullptr) {
+			m_start = Tracer::now();
+		}
+	}
+	~TraceScope() {
+		if (m_name != nullptr) {
+			Tracer::record(m_name, m_start, Tracer::now());
+		}
+	}
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+protected:
+	//! Name of the scope, null when the tracer was not recording
+	const char* m_name;
+	int64_t m_start{ 0 };
+};
+
+#ifdef TEXTURECUBE_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __COUNTER__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+// The scope of the whole function, named after it
+#define TRACE_FUNCTION() TRACE_SCOPE(__func__)
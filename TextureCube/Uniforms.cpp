@@ -5,6 +5,7 @@
 #include "TextureCubeApp.h"
 
 void TextureCubeApp::createDescriptorSetLayout() {
+	TRACE_FUNCTION();
 
 	VkDescriptorSetLayoutBinding uboLayoutBinding{};
 	uboLayoutBinding.binding = 0;
@@ -36,30 +37,53 @@ void TextureCubeApp::createDescriptorSetLayout() {
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 	layoutInfo.pBindings = bindings.data();
 
-	if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDescriptorSetLayout) != VK_SUCCESS) {
+	if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, mHostCallbacks, &mDescriptorSetLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor set layout!");
 	}
 }
 
 void TextureCubeApp::createUniformBuffers() {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-	mUniformBuffers.resize(mSwapChainImages.size());
-	mUniformBuffersMemory.resize(mSwapChainImages.size());
+	TRACE_FUNCTION();
+	// A slice per frame in flight, each starting where a descriptor can point to
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+	VkDeviceSize sliceSize = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+
+	createBuffer(sliceSize * mFrames.size(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+			mUniformBuffer, mUniformMemory, MemoryCategory::Uniform);
+	// Coherent, so it can stay mapped and the writes need no flush
+	char* data;
+	vkMapMemory(mDevice, mUniformMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&data));
+	for (size_t i = 0; i < mFrames.size(); i++) {
+		mFrames[i].uniformOffset = i * sliceSize;
+		mFrames[i].uniformData = data + i * sliceSize;
+	}
+}
 
-	for (size_t i = 0; i < mSwapChainImages.size(); i++) {
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-				mUniformBuffers[i], mUniformBuffersMemory[i]);
+void TextureCubeApp::destroyUniformBuffers() {
+	vkUnmapMemory(mDevice, mUniformMemory);
+	vkDestroyBuffer(mDevice, mUniformBuffer, mHostCallbacks);
+	freeMemory(mUniformMemory);
+	for (auto& frame : mFrames) {
+		frame.uniformData = nullptr;
 	}
+
+	vkDestroyDescriptorPool(mDevice, mDescriptorPool, mHostCallbacks);
 }
 
-void TextureCubeApp::updateUniformBuffer(uint32_t currentImage) {
+void TextureCubeApp::updateUniformBuffer(FrameContext& frame) {
+	TRACE_FUNCTION();
 	static auto startTime = std::chrono::high_resolution_clock::now();
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	// get the time between franmes
 	float time = 
 		std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	// With a fixed step every run animates the same frames, whatever the frame rate
+	if (mFixedTimeStep > 0.0f) {
+		time = mSimulationTime;
+	}
 	// Calculate the uniform's values for this frame
 	UniformBufferObject ubo{};
 	// Model
@@ -88,52 +112,56 @@ void TextureCubeApp::updateUniformBuffer(uint32_t currentImage) {
 	   If you don't do this, then the image will be rendered upside down.
 	*/
 	ubo.proj[1][1] *= -1;
+	// The bounds of the instances are in model space, so cull in model space too
+	mFrustum = Frustum::fromMatrix(ubo.proj * ubo.view * ubo.model);
 
-	void* data;
-	vkMapMemory(mDevice, mUniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(mDevice, mUniformBuffersMemory[currentImage]);
+	// The frame's value was waited on, the GPU no longer reads its slice
+	memcpy(frame.uniformData, &ubo, sizeof(ubo));
 }
 
 void TextureCubeApp::createDescriptorPool() {
+	TRACE_FUNCTION();
 	std::array<VkDescriptorPoolSize, 3> poolSizes{};
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(mSwapChainImages.size());
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(mFrames.size());
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(mSwapChainImages.size());
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(mFrames.size());
 	poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[2].descriptorCount = static_cast<uint32_t>(mSwapChainImages.size());
+	poolSizes[2].descriptorCount = static_cast<uint32_t>(mFrames.size());
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(mSwapChainImages.size());
+	poolInfo.maxSets = static_cast<uint32_t>(mFrames.size());
 
-	if (vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescriptorPool) != VK_SUCCESS) {
+	if (vkCreateDescriptorPool(mDevice, &poolInfo, mHostCallbacks, &mDescriptorPool) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor pool!");
 	}
 }
 
 void TextureCubeApp::createDescriptorSets() {
-	// We need one descriptor set per image in the swapcahin
-	std::vector<VkDescriptorSetLayout> layouts(mSwapChainImages.size(), mDescriptorSetLayout);
+	TRACE_FUNCTION();
+	// We need one descriptor set per frame in flight, each reading its own uniforms
+	std::vector<VkDescriptorSetLayout> layouts(mFrames.size(), mDescriptorSetLayout);
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = mDescriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(mSwapChainImages.size());
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(mFrames.size());
 	allocInfo.pSetLayouts = layouts.data();
 
-	mDescriptorSets.resize(mSwapChainImages.size());
+	std::vector<VkDescriptorSet> descriptorSets(mFrames.size());
 
-	if (vkAllocateDescriptorSets(mDevice, &allocInfo, mDescriptorSets.data()) != VK_SUCCESS) {
+	if (vkAllocateDescriptorSets(mDevice, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < mSwapChainImages.size(); i++) {
+	for (size_t i = 0; i < mFrames.size(); i++) {
+		mFrames[i].descriptorSet = descriptorSets[i];
+
 		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = mUniformBuffers[i];
-		bufferInfo.offset = 0;
+		bufferInfo.buffer = mUniformBuffer;
+		bufferInfo.offset = mFrames[i].uniformOffset;
 		bufferInfo.range = sizeof(UniformBufferObject);
 
 		VkDescriptorImageInfo imageInfoSpecular{};
@@ -149,7 +177,7 @@ void TextureCubeApp::createDescriptorSets() {
 		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
 
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = mDescriptorSets[i];
+		descriptorWrites[0].dstSet = mFrames[i].descriptorSet;
 		descriptorWrites[0].dstBinding = 0; // As described in the shader
 		descriptorWrites[0].dstArrayElement = 0;
 		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -157,7 +185,7 @@ void TextureCubeApp::createDescriptorSets() {
 		descriptorWrites[0].pBufferInfo = &bufferInfo;
 
 		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = mDescriptorSets[i];
+		descriptorWrites[1].dstSet = mFrames[i].descriptorSet;
 		descriptorWrites[1].dstBinding = 1;
 		descriptorWrites[1].dstArrayElement = 0;
 		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -165,7 +193,7 @@ void TextureCubeApp::createDescriptorSets() {
 		descriptorWrites[1].pImageInfo = &imageInfoSpecular;
 		
 		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[2].dstSet = mDescriptorSets[i];
+		descriptorWrites[2].dstSet = mFrames[i].descriptorSet;
 		descriptorWrites[2].dstBinding = 2;
 		descriptorWrites[2].dstArrayElement = 0;
 		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -0,0 +1,310 @@
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "Upload.h"
+#include "TextureCubeApp.h"
+
+void TextureCubeApp::createUploadResources() {
+	TRACE_FUNCTION();
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(mPhysicalDevice);
+	mGraphicsFamily = queueFamilyIndices.graphicsFamily.value();
+	mTransferFamily = queueFamilyIndices.transferFamily.value();
+	// Upload command buffers are short lived, and freed one by one
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = mTransferFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	if (vkCreateCommandPool(mDevice, &poolInfo, mHostCallbacks, &mTransferCommandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transfer command pool!");
+	}
+	// Tells the graphics queue how far the copies are, the rest of the upload
+	// goes on the frame timeline
+	mTransferTimeline = createTimelineSemaphore();
+	mTransferTimelineValue = 0;
+	// Copies and mipmaps are timed on the queue that runs them
+	mTransferProfiler = std::make_unique<GpuProfiler>(mDevice, mPhysicalDevice, mTransferFamily,
+		UPLOAD_PROFILER_SLOTS, 1, mHostQueryResetSupported, mHostCallbacks);
+	mUploadProfiler = std::make_unique<GpuProfiler>(mDevice, mPhysicalDevice, mGraphicsFamily,
+		UPLOAD_PROFILER_SLOTS, 1, mHostQueryResetSupported, mHostCallbacks);
+	// Dedicated transfer queues often have no timestamps (timestampValidBits of 0),
+	// or can not reset them without hostQueryReset. Then the copies are not timed
+	if (!mTransferProfiler->enabled()) {
+		std::cout << "[gpu] the transfer queue can not write timestamps, the upload copies are not timed"
+			<< std::endl;
+	}
+}
+
+void TextureCubeApp::destroyUploadResources() {
+	// Everything must be already done by now
+	releaseFinishedUploads();
+	mTransferProfiler.reset();
+	mUploadProfiler.reset();
+
+	vkDestroySemaphore(mDevice, mTransferTimeline, mHostCallbacks);
+	vkDestroyCommandPool(mDevice, mTransferCommandPool, mHostCallbacks);
+}
+
+UploadBatch TextureCubeApp::beginUpload() {
+	UploadBatch batch;
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+	// One for the copies
+	allocInfo.commandPool = mTransferCommandPool;
+	if (vkAllocateCommandBuffers(mDevice, &allocInfo, &batch.transferCommands) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffers!");
+	}
+	// And one for the graphics side (ownership and post processing)
+	allocInfo.commandPool = mCommandPool;
+	if (vkAllocateCommandBuffers(mDevice, &allocInfo, &batch.graphicsCommands) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffers!");
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(batch.transferCommands, &beginInfo);
+	vkBeginCommandBuffer(batch.graphicsCommands, &beginInfo);
+	// Batches take the slots in turns. If the batch that had the slot is still
+	// pending, this one is simply not timed
+	batch.profilerSlot = mNextUploadSlot;
+	mNextUploadSlot = (mNextUploadSlot + 1) % UPLOAD_PROFILER_SLOTS;
+	if (mTransferProfiler->beginSlot(batch.transferCommands, batch.profilerSlot)) {
+		batch.transferScope = mTransferProfiler->beginScope(batch.transferCommands,
+			batch.profilerSlot, "upload copies");
+	}
+	if (mUploadProfiler->beginSlot(batch.graphicsCommands, batch.profilerSlot)) {
+		batch.graphicsScope = mUploadProfiler->beginScope(batch.graphicsCommands,
+			batch.profilerSlot, "upload graphics");
+	}
+
+	return batch;
+}
+
+VkBuffer TextureCubeApp::stageUploadData(UploadBatch& batch, const void* data, VkDeviceSize size) {
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer, stagingBufferMemory, MemoryCategory::Staging);
+	// Fill the staging buffer with the data
+	void* mapped;
+	vkMapMemory(mDevice, stagingBufferMemory, 0, size, 0, &mapped);
+	memcpy(mapped, data, static_cast<size_t>(size));
+	vkUnmapMemory(mDevice, stagingBufferMemory);
+	// It will be released once the batch is completed
+	batch.stagingBuffers.push_back(stagingBuffer);
+	batch.stagingMemories.push_back(stagingBufferMemory);
+
+	return stagingBuffer;
+}
+
+void TextureCubeApp::uploadBuffer(UploadBatch& batch, const void* data, VkDeviceSize size,
+	VkBuffer dstBuffer, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage,
+	VkDeviceSize dstOffset) {
+
+	VkBuffer stagingBuffer = stageUploadData(batch, data, size);
+	// Copy the stagging buffer (which is on host shared mem) into the
+	// destination buffer (which is on device vid mem)
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = 0; // Optional
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(batch.transferCommands, stagingBuffer, dstBuffer, 1, &copyRegion);
+
+	if (mTransferFamily == mGraphicsFamily) {
+		// Same queue family, the semaphore wait is all the synchronization we need
+		return;
+	}
+	// Release the buffer from the transfer queue...
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = mTransferFamily;
+	barrier.dstQueueFamilyIndex = mGraphicsFamily;
+	barrier.buffer = dstBuffer;
+	// Only the range we wrote, the rest of the buffer may be in use on the graphics queue
+	barrier.offset = dstOffset;
+	barrier.size = size;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(batch.transferCommands,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+	// ...and acquire it on the graphics one
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(batch.graphicsCommands,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void TextureCubeApp::uploadImage(UploadBatch& batch, const void* pixels, VkDeviceSize size,
+	VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels) {
+
+	VkBuffer stagingBuffer = stageUploadData(batch, pixels, size);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	// Get all the levels ready to be written
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(batch.transferCommands,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+	// Copy the first level, the rest comes from the mipmap generation
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = {
+		width,
+		height,
+		1
+	};
+
+	vkCmdCopyBufferToImage(batch.transferCommands, stagingBuffer, image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	if (mTransferFamily == mGraphicsFamily) {
+		// Same queue family, the semaphore wait is all the synchronization we need
+		return;
+	}
+	// Hand the image (still in TRANSFER_DST) over to the graphics queue,
+	// where the mipmaps are generated
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = mTransferFamily;
+	barrier.dstQueueFamilyIndex = mGraphicsFamily;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(batch.transferCommands,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(batch.graphicsCommands,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier);
+}
+
+void TextureCubeApp::submitUpload(UploadBatch& batch) {
+	mTransferProfiler->endScope(batch.transferCommands, batch.profilerSlot, batch.transferScope);
+	mUploadProfiler->endScope(batch.graphicsCommands, batch.profilerSlot, batch.graphicsScope);
+	vkEndCommandBuffer(batch.transferCommands);
+	vkEndCommandBuffer(batch.graphicsCommands);
+	// First the copies on the transfer queue. Only this queue signals the transfer
+	// timeline: the signals of a timeline must grow in execution order, and nothing
+	// orders the transfer submits against the graphics ones
+	uint64_t copiesDone = ++mTransferTimelineValue;
+	VkTimelineSemaphoreSubmitInfo transferTimeline{};
+	transferTimeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	transferTimeline.signalSemaphoreValueCount = 1;
+	transferTimeline.pSignalSemaphoreValues = &copiesDone;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &transferTimeline;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.transferCommands;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &mTransferTimeline;
+
+	if (vkQueueSubmit(mTransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+	// Then the graphics side, once the copies are done. It takes the next value
+	// of the frame timeline, like everything else on the graphics queue
+	uint64_t batchDone = ++mFrameTimelineValue;
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkTimelineSemaphoreSubmitInfo graphicsTimeline{};
+	graphicsTimeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	graphicsTimeline.waitSemaphoreValueCount = 1;
+	graphicsTimeline.pWaitSemaphoreValues = &copiesDone;
+	graphicsTimeline.signalSemaphoreValueCount = 1;
+	graphicsTimeline.pSignalSemaphoreValues = &batchDone;
+
+	submitInfo.pNext = &graphicsTimeline;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &mTransferTimeline;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.pCommandBuffers = &batch.graphicsCommands;
+	submitInfo.pSignalSemaphores = &mFrameTimeline;
+
+	if (vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+	// No waiting here, the frames wait on the GPU for mLastUploadValue
+	batch.timelineValue = batchDone;
+	mLastUploadValue = batchDone;
+	if (batch.transferScope != GpuProfiler::NO_SCOPE) {
+		mTransferProfiler->submitSlot(batch.profilerSlot);
+	}
+	if (batch.graphicsScope != GpuProfiler::NO_SCOPE) {
+		mUploadProfiler->submitSlot(batch.profilerSlot);
+	}
+	mPendingUploads.push_back(batch);
+}
+
+void TextureCubeApp::releaseFinishedUploads() {
+	if (mPendingUploads.empty()) {
+		return;
+	}
+	uint64_t completedValue;
+	vkGetSemaphoreCounterValue(mDevice, mFrameTimeline, &completedValue);
+
+	auto it = mPendingUploads.begin();
+	while (it != mPendingUploads.end()) {
+		if (it->timelineValue > completedValue) {
+			++it;
+			continue;
+		}
+		for (size_t i = 0; i < it->stagingBuffers.size(); i++) {
+			vkDestroyBuffer(mDevice, it->stagingBuffers[i], mHostCallbacks);
+			freeMemory(it->stagingMemories[i]);
+		}
+		// The times go to the totals of the profilers
+		std::vector<GpuScopeTime> scopes;
+		if (it->transferScope != GpuProfiler::NO_SCOPE) {
+			mTransferProfiler->collect(it->profilerSlot, scopes);
+		}
+		if (it->graphicsScope != GpuProfiler::NO_SCOPE) {
+			mUploadProfiler->collect(it->profilerSlot, scopes);
+		}
+		vkFreeCommandBuffers(mDevice, mTransferCommandPool, 1, &it->transferCommands);
+		vkFreeCommandBuffers(mDevice, mCommandPool, 1, &it->graphicsCommands);
+		it = mPendingUploads.erase(it);
+	}
+}
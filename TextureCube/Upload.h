@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "GpuProfiler.h"
+
+// A group of uploads recorded together. The copies run on the transfer queue,
+// then the graphics queue takes the ownership of the resources (and can do
+// some extra work on them, like the mipmaps) once the copies are done.
+// The copies signal the transfer timeline, the graphics step waits on it and
+// signals the frame timeline, where the frames wait for it
+struct UploadBatch {
+	VkCommandBuffer transferCommands{ VK_NULL_HANDLE };
+	VkCommandBuffer graphicsCommands{ VK_NULL_HANDLE };
+	// Staging buffers can not be released until the copies are done
+	std::vector<VkBuffer> stagingBuffers;
+	std::vector<VkDeviceMemory> stagingMemories;
+	// Value of the frame timeline that marks the batch as completed
+	uint64_t timelineValue{ 0 };
+	// Slot of the batch in the upload profilers, and its scope on each queue
+	uint32_t profilerSlot{ 0 };
+	uint32_t transferScope{ GpuProfiler::NO_SCOPE };
+	uint32_t graphicsScope{ GpuProfiler::NO_SCOPE };
+};
@@ -4,19 +4,24 @@ bool Vertex::operator==(const Vertex& other) const {
 	return pos == other.pos && normal == other.normal && texCoord == other.texCoord;
 }
 
-VkVertexInputBindingDescription Vertex::getBindingDescription() {
+std::array<VkVertexInputBindingDescription, 2> Vertex::getBindingDescriptions() {
 
-	VkVertexInputBindingDescription bindingDescription{};
-	bindingDescription.binding = 0;
-	bindingDescription.stride = sizeof(Vertex);
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
 
-	return bindingDescription;
+	bindingDescriptions[0].binding = 0;
+	bindingDescriptions[0].stride = sizeof(Vertex);
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(InstanceData);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	return bindingDescriptions;
 }
 
-std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescriptions() {
+std::array<VkVertexInputAttributeDescription, 8> Vertex::getAttributeDescriptions() {
 	
-	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+	std::array<VkVertexInputAttributeDescription, 8> attributeDescriptions{};
 
 	attributeDescriptions[0].binding = 0;
 	attributeDescriptions[0].location = 0;
@@ -33,5 +38,19 @@ std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescription
 	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
 	attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
 
+	// A mat4 does not fit in one location, it takes one per column
+	for (uint32_t column = 0; column < 4; column++) {
+		attributeDescriptions[3 + column].binding = 1;
+		attributeDescriptions[3 + column].location = 3 + column;
+		attributeDescriptions[3 + column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[3 + column].offset = 
+			static_cast<uint32_t>(offsetof(InstanceData, model) + column * sizeof(glm::vec4));
+	}
+
+	attributeDescriptions[7].binding = 1;
+	attributeDescriptions[7].location = 7;
+	attributeDescriptions[7].format = VK_FORMAT_R32_UINT;
+	attributeDescriptions[7].offset = offsetof(InstanceData, materialId);
+
 	return attributeDescriptions;
 }
@@ -15,11 +15,18 @@ struct Vertex
 	glm::vec3 normal;
 	glm::vec2 texCoord;
 
-	static VkVertexInputBindingDescription getBindingDescription();
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
+	// Binding 0 has the vertices, binding 1 the per instance data
+	static std::array<VkVertexInputBindingDescription, 2> getBindingDescriptions();
+	static std::array<VkVertexInputAttributeDescription, 8> getAttributeDescriptions();
 
 	bool operator==(const Vertex& other) const;
 };
+// Data of every copy of the mesh, it advances once per instance (not per vertex)
+struct InstanceData
+{
+	glm::mat4 model;
+	uint32_t materialId;
+};
 // Implement a hash function for the vertex struct
 // See: https://en.cppreference.com/w/cpp/utility/hash
 // and: https://vulkan-tutorial.com/Loading_models#page_Vertex-deduplication
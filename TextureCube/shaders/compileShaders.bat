@@ -1,3 +0,0 @@
-C:/VulkanSDK/1.2.170.0/Bin/glslc.exe simple.vert -o vert.spv
-C:/VulkanSDK/1.2.170.0/Bin/glslc.exe simple.frag -o frag.spv
-pause
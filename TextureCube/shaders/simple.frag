@@ -6,22 +6,58 @@ layout(binding = 2) uniform sampler2D diffTexSampler;
 
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterialId;
 
 layout(location = 0) out vec4 outColor;
 
+// Set per pipeline (ShadingConstants on the C++ side). A pipeline built for a
+// single material gets its features as constants, so the compiler folds them
+// and drops the texture fetches it does not use. With MATERIAL = -1 the
+// features are looked up per fragment, for the draws that mix materials
+layout(constant_id = 0) const int MATERIAL = -1;
+layout(constant_id = 1) const bool DIFFUSE_TEXTURE = true;
+layout(constant_id = 2) const bool SPECULAR_TEXTURE = true;
+layout(constant_id = 3) const float SHININESS = 4.0;
+layout(constant_id = 4) const float LIGHT_X = 0.0;
+layout(constant_id = 5) const float LIGHT_Y = 0.75;
+layout(constant_id = 6) const float LIGHT_Z = 1.0;
+
+// Tint of each material, the first one leaves the texture as it is
+const vec3 materialTints[4] = vec3[](
+    vec3(1.0), vec3(1.0, 0.6, 0.5), vec3(0.5, 1.0, 0.6), vec3(0.6, 0.7, 1.0));
+// Features of each material, same table as materialShading in Pipeline.cpp
+const bool materialDiffuse[4] = bool[](true, true, true, false);
+const bool materialSpecular[4] = bool[](true, false, true, false);
+const float materialShininess[4] = float[](4.0, 4.0, 32.0, 4.0);
+
 void main() {
+    bool perFragment = MATERIAL < 0;
+    uint material = perFragment ? fragMaterialId % 4 : uint(MATERIAL);
+    bool diffuseTexture = perFragment ? materialDiffuse[material] : DIFFUSE_TEXTURE;
+    bool specularTexture = perFragment ? materialSpecular[material] : SPECULAR_TEXTURE;
+    float alpha = perFragment ? materialShininess[material] : SHININESS;
     //Since we are in view space
     vec3 v = vec3(0.0);
     // This is a directional light
-    vec3 l = normalize(vec3(0.0, 0.75, 1.0));
+    vec3 l = normalize(vec3(LIGHT_X, LIGHT_Y, LIGHT_Z));
     vec3 n = normalize(fragNormal);
     vec3 r = normalize(reflect(-l, n));
     vec3 h = normalize(l + v);
-    //Material from texture
-    vec3 Ka = 0.1 * texture(diffTexSampler, fragTexCoord).rgb;
-    vec3 Kd = 0.9 * texture(diffTexSampler, fragTexCoord).rgb;
-    vec3 Ks = texture(specTexSampler, fragTexCoord).rgb;
-    float alpha = 4.0;
+    //Material from texture. The branches only depend on constants, so the
+    //sampling stays in uniform control flow
+    vec3 albedo = vec3(1.0);
+    if (perFragment || DIFFUSE_TEXTURE) {
+        vec3 texel = texture(diffTexSampler, fragTexCoord).rgb;
+        albedo = diffuseTexture ? texel : albedo;
+    }
+    vec3 Ks = vec3(0.0);
+    if (perFragment || SPECULAR_TEXTURE) {
+        vec3 texel = texture(specTexSampler, fragTexCoord).rgb;
+        Ks = specularTexture ? texel : Ks;
+    }
+    vec3 tint = materialTints[material];
+    vec3 Ka = 0.1 * tint * albedo;
+    vec3 Kd = 0.9 * tint * albedo;
     //Light's color (all components are white)
     vec3 La = vec3(1.0);
     vec3 Ls = vec3(1.0);
@@ -10,12 +10,18 @@ layout(binding = 0) uniform UniformBufferObject {
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoord;
+// Per instance (a mat4 takes locations 3 to 6)
+layout(location = 3) in mat4 inInstanceModel;
+layout(location = 7) in uint inMaterialId;
 
 layout(location = 0) out vec3 fragNormal;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialId;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragNormal = vec3(inverse(transpose(ubo.view * ubo.model)) * vec4(inNormal, 0.0));
+    mat4 modelView = ubo.view * ubo.model * inInstanceModel;
+    gl_Position = ubo.proj * modelView * vec4(inPosition, 1.0);
+    fragNormal = vec3(inverse(transpose(modelView)) * vec4(inNormal, 0.0));
     fragTexCoord = inTexCoord;
+    fragMaterialId = inMaterialId;
 }